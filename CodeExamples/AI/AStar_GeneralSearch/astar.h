@@ -1,10 +1,9 @@
 #ifndef ASTAR
 #define ASTAR
 #include <vector>
-#include <queue>
 #include <float.h>
-#include <map>
 #include <algorithm>
+#include "indexed_heap.h"
 
 enum ListStatus
 {
@@ -13,6 +12,14 @@ enum ListStatus
   Closed
 };
 
+enum SearchMode
+{
+  Forward = 0,
+  //grows from both ends, needs GraphType::GetInEdges (edges into a vertex,
+  //GetID1 is where they come from) and a consistent heuristic
+  Bidirectional
+};
+
 //callback object for Astar
 template <typename GraphType, typename AstarType>
 class Callback {
@@ -29,90 +36,109 @@ template <typename GraphType, typename Heuristic>
 class Astar {
 public:
 
-  struct AStarNode
+  //everything a search knows about one vertex, kept in a flat array indexed by
+  //vertex id; an entry whose generation is not the current one is unvisited,
+  //so a new search resets all of them by bumping the generation
+  struct VertexState
   {
-    AStarNode() : id(-1), parentId(-1), Fcost(0.0f), cost(0.0f)
-    {}
-    AStarNode(size_t Id, size_t parent, float Cost = 0.0f, float FCost = 0.0f) : id(Id), parentId(parent), Fcost(FCost), cost(Cost)
+    VertexState() : cost(0.0f), heuristic(0.0f), parentId(-1), generation(0), status(None)
     {}
 
-    size_t id;
-    size_t parentId;
-    float Fcost;
     float cost;
-
-    friend bool operator>(const AStarNode& lhs, const AStarNode& rhs)
-    {
-      return lhs.Fcost > rhs.Fcost;
-    }
-
-    friend bool operator<(const AStarNode& lhs, const AStarNode& rhs)
-    {
-      return lhs.Fcost < rhs.Fcost;
-    }
-
-    friend bool operator==(const AStarNode& lhs, const AStarNode& rhs)
-    {
-      return lhs.id == rhs.id;
-    }
+    float heuristic;
+    size_t parentId;
+    unsigned generation;
+    ListStatus status;
   };
 
   typedef std::vector<typename GraphType::Edge> SolutionContainer;
-  typedef std::priority_queue < AStarNode, std::vector<AStarNode>, std::greater<AStarNode>> OpenListContainer;
-  typedef std::map<size_t, AStarNode> ClosedListContainer;
-
-  template <class T, class S, class C>
-  S& Container(std::priority_queue<T, S, C>& q)
-  {
-    struct HackedQueue : private std::priority_queue<T, S, C>
-    {
-      static S& Container(std::priority_queue<T, S, C>& q)
-      {
-        return q.* & HackedQueue::c;
-      }
-    };
-    return HackedQueue::Container(q);
-  }
+  typedef IndexedHeap<float> OpenListContainer;
+  typedef std::vector<VertexState> VertexStateContainer;
 
   ////////////////////////////////////////////////////////////
   Astar(GraphType const& _graph, Callback<GraphType, Astar>& cb) :
     graph(_graph),
     callback(cb),
+    heuristic(),
+    openlist(),
+    vertices(),
+    backwardlist(),
+    backwardVertices(),
+    solution(),
+    start_id(0),
+    goal_id(0),
+    goalVertex(),
+    startVertex(),
+    pathID(1024),
+    generation(0),
+    settled(0)
+  {}
+
+  //searches with a copy of h, for heuristics that carry precomputed data and
+  //need not be default constructible (LandmarkHeuristic, whose table has to
+  //outlive this)
+  Astar(GraphType const& _graph, Callback<GraphType, Astar>& cb, Heuristic const& h) :
+    graph(_graph),
+    callback(cb),
+    heuristic(h),
     openlist(),
-    closedlist(),
+    vertices(),
+    backwardlist(),
+    backwardVertices(),
     solution(),
     start_id(0),
     goal_id(0),
     goalVertex(),
+    startVertex(),
     pathID(1024),
-    tasks(Container(openlist))
+    generation(0),
+    settled(0)
   {}
   ////////////////////////////////////////////////////////////
 
   void Reset()
   {
-    tasks.clear();
-
-    closedlist.clear();
+    openlist.Clear();
+    backwardlist.Clear();
     solution.clear();
-  }
+    settled = 0;
 
-  void CreatePath(AStarNode& goalNode)
-  {
-    AStarNode curr = goalNode;
+    if (++generation == 0)
+    {
+      //wrapped around, old stamps could look current again
+      for (size_t i = 0; i < vertices.size(); ++i)
+      {
+        vertices[i].generation = 0;
+      }
+      for (size_t i = 0; i < backwardVertices.size(); ++i)
+      {
+        backwardVertices[i].generation = 0;
+      }
+      generation = 1;
+    }
+  }
 
-    pathID.clear();
+  //vertices taken off the open lists by the last search
+  size_t GetSettledCount() const { return settled; }
 
-    while (curr.id != start_id)
+  //state of id, grown on demand so the graph does not have to report its size
+  static VertexState& GetState(VertexStateContainer& states, size_t id)
+  {
+    if (id >= states.size())
     {
-      pathID.push_back(curr.id);
-
-      curr.id = curr.parentId;
-      curr = closedlist[curr.id];
+      states.resize(std::max(id + 1, states.size() * 2));
     }
+    return states[id];
+  }
 
-    pathID.push_back(start_id);
+  bool Visited(VertexStateContainer const& states, size_t id) const
+  {
+    return id < states.size() && states[id].generation == generation;
+  }
 
+  //turns pathID, goal first, into the edges of the solution
+  void CreatePath()
+  {
     size_t pathSize = pathID.size();
 
     for (size_t i = pathSize - 1; i > 0; --i)
@@ -133,103 +159,83 @@ public:
     }
   }
 
-  bool CheckClosedList(AStarNode& node)
+  //walks the forward parents from id back to the start
+  void AddForwardPath(size_t id)
   {
-    AStarNode& curr = closedlist[node.id];
-
-    if (curr.id != size_t(-1))
+    while (id != start_id)
     {
-      if (node.Fcost < curr.Fcost)
-      {
-        curr.id = -1;
-        openlist.push(node);
-      }
-
-      return true;
+      pathID.push_back(id);
+      id = vertices[id].parentId;
     }
 
-    return false;
+    pathID.push_back(start_id);
   }
 
-  bool CheckOpenList(AStarNode& node)
+  //relaxes the edge into nextID, a vertex seen for the first time gets its
+  //potential once, a cheaper path lowers its key in place or reopens it
+  template <typename Potential>
+  void Relax(OpenListContainer& list, VertexStateContainer& states, size_t nextID, size_t parentId, float gCost, Potential& potential)
   {
-    //auto end = tasks.end();
-    //auto openListPos = std::find(tasks.begin(), end, node);
-
-    //if (openListPos != end)
-    //{
-    //  if (node.Fcost < (*openListPos).Fcost)
-    //  {
-    //    std::swap(*openListPos, tasks.back());
-    //    tasks.pop_back();
-    //    openlist.push(node);
-    //  }
+    VertexState& next = GetState(states, nextID);
 
-    //  return true;
-    //}
-
-    //return false;
-
-    int size = int(tasks.size());
-
-    if (!size)
+    if (next.generation != generation)
     {
-      return false;
+      next.generation = generation;
+      next.heuristic = potential(nextID);
+      next.cost = gCost;
+      next.parentId = parentId;
+      next.status = InList;
+      list.Push(nextID, gCost + next.heuristic);
+      return;
     }
 
-    int start = 0;
-    int pos = size;
-    int end = size - 1;
-
-    while (start <= end)
+    if (gCost < next.cost)
     {
-      if (tasks[start].id == node.id)
-      {
-        pos = start;
-        break;
-      }
+      next.cost = gCost;
+      next.parentId = parentId;
 
-      if (tasks[end].id == node.id)
+      if (next.status == InList)
       {
-        pos = end;
-        break;
+        list.DecreaseKey(nextID, gCost + next.heuristic);
       }
-
-      ++start;
-      --end;
-    }
-
-    if (pos != size)
-    {
-      if (node.Fcost < tasks[pos].Fcost)
+      else
       {
-        std::swap(tasks[pos], tasks.back());
-        tasks.pop_back();
-        openlist.push(node);
+        next.status = InList;
+        list.Push(nextID, gCost + next.heuristic);
       }
-
-      return true;
     }
-
-    return false;
   }
 
-  void AddtoOpenList(AStarNode& node)
+  //h(v, goal), what the one way search adds to the cost
+  struct ForwardPotential
   {
-    if (CheckClosedList(node))
+    ForwardPotential(Astar& a, Heuristic& h) : astar(a), heuristic(h) {}
+    float operator()(size_t id)
     {
-      return;
+      return heuristic(astar.graph, astar.graph.GetVertex(id), astar.goalVertex);
     }
+    Astar& astar;
+    Heuristic& heuristic;
+  };
 
-    if (CheckOpenList(node))
+  //average of the two estimates (Ikeda et al.), (h(v, goal) - h(start, v)) / 2
+  //forward and its negation backward; with a consistent heuristic both give
+  //non negative reduced costs and the keys of a path through v add up to its
+  //length, so the frontiers can stop as soon as their tops add up to the best
+  struct BalancedPotential
+  {
+    BalancedPotential(Astar& a, Heuristic& h, float s) : astar(a), heuristic(h), sign(s) {}
+    float operator()(size_t id)
     {
-      return;
+      typename GraphType::Vertex const& vertex = astar.graph.GetVertex(id);
+      return sign * 0.5f * (heuristic(astar.graph, vertex, astar.goalVertex) - heuristic(astar.graph, astar.startVertex, vertex));
     }
+    Astar& astar;
+    Heuristic& heuristic;
+    float sign;
+  };
 
-    openlist.push(node);
-  }
-
-  void AddNeighbours(size_t id, float cost, Heuristic& heuristic)
+  void AddNeighbours(size_t id, float cost, ForwardPotential& potential)
   {
     typename GraphType::Vertex const& vertex = graph.GetVertex(id);
     std::vector<typename GraphType::Edge> const& outedges = graph.GetOutEdges(vertex);
@@ -237,17 +243,44 @@ public:
     size_t outedges_size = outedges.size();
     for (size_t i = 0; i < outedges_size; ++i)
     {
-      size_t nextID = outedges[i].GetID2();
-      float gCost = cost + outedges[i].GetWeight();
-      float hCost = heuristic(graph, graph.GetVertex(nextID), goalVertex);
-      AStarNode curr(nextID, id, gCost, gCost + hCost);
-      AddtoOpenList(curr);
+      Relax(openlist, vertices, outedges[i].GetID2(), id, cost + outedges[i].GetWeight(), potential);
     }
   }
 
-  void AddToClosed(AStarNode& curr)
+  //settles one vertex of one frontier and checks every vertex it reaches
+  //against the other frontier for a shorter meeting point
+  template <bool IsForward>
+  void ExpandBidirectional(BalancedPotential& potential, float& best, size_t& meeting)
   {
-    closedlist[curr.id] = curr;
+    OpenListContainer& list = IsForward ? openlist : backwardlist;
+    VertexStateContainer& states = IsForward ? vertices : backwardVertices;
+    VertexStateContainer const& other = IsForward ? backwardVertices : vertices;
+
+    size_t id = list.Top().id;
+    list.Pop();
+    states[id].status = Closed;
+    ++settled;
+
+    float cost = states[id].cost;
+    typename GraphType::Vertex const& vertex = graph.GetVertex(id);
+    std::vector<typename GraphType::Edge> const& edges = IsForward ? graph.GetOutEdges(vertex) : graph.GetInEdges(vertex);
+
+    size_t edges_size = edges.size();
+    for (size_t i = 0; i < edges_size; ++i)
+    {
+      size_t nextID = IsForward ? edges[i].GetID2() : edges[i].GetID1();
+      Relax(list, states, nextID, id, cost + edges[i].GetWeight(), potential);
+
+      if (Visited(other, nextID))
+      {
+        float length = states[nextID].cost + other[nextID].cost;
+        if (length < best)
+        {
+          best = length;
+          meeting = nextID;
+        }
+      }
+    }
   }
 
   ////////////////////////////////////////////////////////////
@@ -256,28 +289,99 @@ public:
     start_id = startID;
     goal_id = goalID;
     Reset();
-    Heuristic heuristic;
+    ForwardPotential potential(*this, heuristic);
     goalVertex = graph.GetVertex(goal_id);
 
-    AStarNode start(start_id, start_id);
-    openlist.push(start);
+    VertexState& start = GetState(vertices, start_id);
+    start.generation = generation;
+    start.heuristic = 0.0f;
+    start.cost = 0.0f;
+    start.parentId = start_id;
+    start.status = InList;
+    openlist.Push(start_id, 0.0f);
 
-    while (openlist.size() > 0)
+    while (!openlist.Empty())
     {
       callback.OnIteration(*this);
 
-      AStarNode curr = openlist.top();
-      openlist.pop();
+      size_t id = openlist.Top().id;
+      openlist.Pop();
+      vertices[id].status = Closed;
+      ++settled;
 
-      if (curr.id == goal_id)
+      if (id == goal_id)
       {
-        CreatePath(curr);
+        pathID.clear();
+        AddForwardPath(goal_id);
+        CreatePath();
         callback.OnFinish(*this);
         return solution;
       }
 
-      AddNeighbours(curr.id, curr.cost, heuristic);
-      AddToClosed(curr);
+      AddNeighbours(id, vertices[id].cost, potential);
+    }
+
+    callback.OnFinish(*this);
+    return solution;
+  }
+
+  std::vector<typename GraphType::Edge> search(size_t startID, size_t goalID, SearchMode mode)
+  {
+    if (mode == Forward)
+    {
+      return search(startID, goalID);
+    }
+
+    start_id = startID;
+    goal_id = goalID;
+    Reset();
+    goalVertex = graph.GetVertex(goal_id);
+    startVertex = graph.GetVertex(start_id);
+    BalancedPotential forwardPotential(*this, heuristic, 1.0f);
+    BalancedPotential backwardPotential(*this, heuristic, -1.0f);
+
+    Relax(openlist, vertices, start_id, start_id, 0.0f, forwardPotential);
+    Relax(backwardlist, backwardVertices, goal_id, goal_id, 0.0f, backwardPotential);
+
+    //length of the best path through a vertex both frontiers reached
+    float best = FLT_MAX;
+    size_t meeting = size_t(-1);
+    if (start_id == goal_id)
+    {
+      best = 0.0f;
+      meeting = start_id;
+    }
+
+    while (!openlist.Empty() && !backwardlist.Empty())
+    {
+      if (openlist.Top().key + backwardlist.Top().key >= best)
+      {
+        break;
+      }
+
+      callback.OnIteration(*this);
+
+      if (openlist.Top().key <= backwardlist.Top().key)
+      {
+        ExpandBidirectional<true>(forwardPotential, best, meeting);
+      }
+      else
+      {
+        ExpandBidirectional<false>(backwardPotential, best, meeting);
+      }
+    }
+
+    if (meeting != size_t(-1))
+    {
+      //goal .. meeting from the backward parents, then meeting .. start
+      pathID.clear();
+      for (size_t id = meeting; id != goal_id; id = backwardVertices[id].parentId)
+      {
+        pathID.push_back(backwardVertices[id].parentId);
+      }
+      std::reverse(pathID.begin(), pathID.end());
+      AddForwardPath(meeting);
+      CreatePath();
     }
 
     callback.OnFinish(*this);
@@ -288,15 +392,21 @@ private:
   // do not modify the next 2 lines
   const GraphType& graph;
   Callback<GraphType, Astar>& callback;
+  Heuristic heuristic;
   // the next 4 lines are just sugestions
-  // OpenListContainer, ClosedListContainer, SolutionContainer are typedefed
+  // OpenListContainer, VertexStateContainer, SolutionContainer are typedefed
   OpenListContainer            openlist;
-  ClosedListContainer          closedlist;
+  VertexStateContainer         vertices;
+  //the frontier grown from the goal by a bidirectional search
+  OpenListContainer            backwardlist;
+  VertexStateContainer         backwardVertices;
   SolutionContainer            solution;
   size_t                       start_id, goal_id;
   typename GraphType::Vertex goalVertex;
+  typename GraphType::Vertex startVertex;
   std::vector<size_t> pathID;
-  std::vector<AStarNode>& tasks;
+  unsigned generation;
+  size_t settled;
 };
 
 #endif
@@ -0,0 +1,374 @@
+//Shortest path benchmark and cross check on a random weighted grid
+//every query is answered by Dijkstra and by each engine: Astar forward and
+//bidirectional with a euclidean heuristic, ALT with float and uint16_t tables
+//and the contraction hierarchy; paths must have the Dijkstra length. One CSV
+//row per engine with its preprocessing time, query time and settled vertices.
+//build: g++ -O2 -std=c++17 astar_bench.cpp -o astar_bench
+//usage: astar_bench [-w width] [-q queries] [-l landmarks] [-s seed]
+//the grid is width x width, -w 1000 is the million vertex graph;
+//exits with 1 when any engine returned a wrong path
+#include "astar.h"
+#include "landmarks.h"
+#include "contraction.h"
+#include <iostream>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <cfloat>
+#include <algorithm>
+
+//4-neighbour grid, edge weights are the step length times a random factor
+//in [1, 4), a few edges are missing so shortest paths have to go around
+class GridGraph
+{
+public:
+  struct Vertex
+  {
+    size_t id;
+    float x;
+    float y;
+    size_t GetID() const { return id; }
+  };
+
+  struct Edge
+  {
+    size_t id1;
+    size_t id2;
+    float weight;
+    size_t GetID1() const { return id1; }
+    size_t GetID2() const { return id2; }
+    float GetWeight() const { return weight; }
+  };
+
+  GridGraph(int Width, unsigned Seed) : width(Width), vertices(), out(), in()
+  {
+    size_t count = size_t(width) * width;
+    vertices.resize(count);
+    out.resize(count);
+    in.resize(count);
+
+    std::mt19937 rng(Seed);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    for (int y = 0; y < width; ++y)
+    {
+      for (int x = 0; x < width; ++x)
+      {
+        size_t id = size_t(y) * width + x;
+        vertices[id].id = id;
+        vertices[id].x = float(x);
+        vertices[id].y = float(y);
+
+        if (x + 1 < width && uniform(rng) > 0.05f)
+        {
+          Connect(id, id + 1, 1.0f + 3.0f * uniform(rng));
+        }
+        if (y + 1 < width && uniform(rng) > 0.05f)
+        {
+          Connect(id, id + width, 1.0f + 3.0f * uniform(rng));
+        }
+      }
+    }
+  }
+
+  size_t GetVertexCount() const { return vertices.size(); }
+  Vertex const& GetVertex(size_t id) const { return vertices[id]; }
+  std::vector<Edge> const& GetOutEdges(Vertex const& v) const { return out[v.id]; }
+  std::vector<Edge> const& GetInEdges(Vertex const& v) const { return in[v.id]; }
+
+private:
+  void Connect(size_t a, size_t b, float weight)
+  {
+    Edge ab = { a, b, weight };
+    Edge ba = { b, a, weight };
+    out[a].push_back(ab);
+    in[b].push_back(ab);
+    out[b].push_back(ba);
+    in[a].push_back(ba);
+  }
+
+  int width;
+  std::vector<Vertex> vertices;
+  std::vector< std::vector<Edge> > out;
+  std::vector< std::vector<Edge> > in;
+};
+
+//straight line distance, every edge weighs at least its length
+struct Euclid
+{
+  float operator()(GridGraph const&, GridGraph::Vertex const& a, GridGraph::Vertex const& b) const
+  {
+    return std::sqrt((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y));
+  }
+};
+
+//reference distances, the arrays are kept between queries and an entry is
+//only valid when its stamp is the current query's
+class Dijkstra
+{
+public:
+  Dijkstra(GridGraph const& Graph) :
+    graph(Graph),
+    distance(Graph.GetVertexCount(), FLT_MAX),
+    stamp(Graph.GetVertexCount(), 0),
+    done(Graph.GetVertexCount(), 0),
+    current(0),
+    heap()
+  {
+    heap.Reserve(Graph.GetVertexCount());
+  }
+
+  //FLT_MAX when goal can not be reached
+  float Distance(size_t start, size_t goal, size_t& settled)
+  {
+    ++current;
+    heap.Clear();
+    Reach(start, 0.0f);
+    settled = 0;
+
+    while (!heap.Empty())
+    {
+      size_t v = heap.Top().id;
+      heap.Pop();
+      done[v] = current;
+      ++settled;
+      if (v == goal)
+      {
+        return distance[v];
+      }
+
+      std::vector<GridGraph::Edge> const& edges = graph.GetOutEdges(graph.GetVertex(v));
+      for (size_t i = 0; i < edges.size(); ++i)
+      {
+        if (done[edges[i].GetID2()] != current)
+        {
+          Reach(edges[i].GetID2(), distance[v] + edges[i].GetWeight());
+        }
+      }
+    }
+
+    return FLT_MAX;
+  }
+
+private:
+  void Reach(size_t v, float length)
+  {
+    if (stamp[v] != current)
+    {
+      stamp[v] = current;
+      distance[v] = length;
+      heap.Push(v, length);
+    }
+    else if (length < distance[v])
+    {
+      distance[v] = length;
+      heap.DecreaseKey(v, length);
+    }
+  }
+
+  GridGraph const& graph;
+  std::vector<float> distance;
+  std::vector<unsigned> stamp;
+  std::vector<unsigned> done;
+  unsigned current;
+  IndexedHeap<float> heap;
+};
+
+//length of a path of edges from start to goal, -1 when the edges do not
+//form one
+float PathLength(std::vector<GridGraph::Edge> const& path, size_t start, size_t goal)
+{
+  if (path.empty())
+  {
+    return start == goal ? 0.0f : -1.0f;
+  }
+
+  float length = 0.0f;
+  size_t at = start;
+  for (size_t i = 0; i < path.size(); ++i)
+  {
+    if (path[i].GetID1() != at)
+    {
+      return -1.0f;
+    }
+    length += path[i].GetWeight();
+    at = path[i].GetID2();
+  }
+  return at == goal ? length : -1.0f;
+}
+
+struct Query
+{
+  size_t start;
+  size_t goal;
+  float distance;
+};
+
+//totals of one engine over all queries
+struct Tally
+{
+  Tally() : seconds(0.0), settled(0), wrong(0) {}
+  double seconds;
+  unsigned long long settled;
+  int wrong;
+};
+
+//an unreachable goal must give an empty path, any other a path as short as
+//Dijkstra's, float sums in a different order may differ in the last bits
+bool Agrees(std::vector<GridGraph::Edge> const& path, Query const& query)
+{
+  if (query.distance == FLT_MAX)
+  {
+    return path.empty() && query.start != query.goal;
+  }
+  float length = PathLength(path, query.start, query.goal);
+  return length >= 0.0f && std::fabs(length - query.distance) <= 1e-4f * query.distance + 1e-3f;
+}
+
+double Since(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Print(const char* engine, int width, size_t vertices, std::vector<Query> const& queries, double preprocess, Tally const& tally)
+{
+  std::cout << engine << ','
+    << width << 'x' << width << ','
+    << vertices << ','
+    << queries.size() << ','
+    << preprocess << ','
+    << tally.seconds / queries.size() * 1e6 << ','
+    << tally.settled / queries.size() << ','
+    << tally.wrong << std::endl;
+}
+
+//Astar over every query in one mode
+template <typename Heuristic>
+Tally RunAstar(Astar<GridGraph, Heuristic>& astar, std::vector<Query> const& queries, SearchMode mode)
+{
+  Tally tally;
+  for (size_t i = 0; i < queries.size(); ++i)
+  {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<GridGraph::Edge> path = astar.search(queries[i].start, queries[i].goal, mode);
+    tally.seconds += Since(start);
+    tally.settled += astar.GetSettledCount();
+    tally.wrong += Agrees(path, queries[i]) ? 0 : 1;
+  }
+  return tally;
+}
+
+int main(int argc, char** argv)
+{
+  int width = 300;
+  int queryCount = 200;
+  unsigned landmarkCount = 16;
+  unsigned seed = 1;
+
+  for (int i = 1; i + 1 < argc; i += 2)
+  {
+    if (!std::strcmp(argv[i], "-w")) width = std::max(2, std::atoi(argv[i + 1]));
+    else if (!std::strcmp(argv[i], "-q")) queryCount = std::max(1, std::atoi(argv[i + 1]));
+    else if (!std::strcmp(argv[i], "-l")) landmarkCount = unsigned(std::max(0, std::atoi(argv[i + 1])));
+    else if (!std::strcmp(argv[i], "-s")) seed = unsigned(std::atoi(argv[i + 1]));
+    else
+    {
+      std::cerr << "unknown option " << argv[i] << std::endl;
+      return 1;
+    }
+  }
+
+  GridGraph graph(width, seed);
+  size_t vertices = graph.GetVertexCount();
+
+  //random pairs, the reference distances first
+  std::mt19937 rng(seed + 1);
+  std::vector<Query> queries(queryCount);
+  Dijkstra reference(graph);
+  Tally dijkstra;
+  for (int i = 0; i < queryCount; ++i)
+  {
+    queries[i].start = rng() % vertices;
+    queries[i].goal = rng() % vertices;
+    size_t settled;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    queries[i].distance = reference.Distance(queries[i].start, queries[i].goal, settled);
+    dijkstra.seconds += Since(start);
+    dijkstra.settled += settled;
+  }
+
+  std::cout << "engine,graph,vertices,queries,preprocess_s,query_us,settled_per_query,wrong" << std::endl;
+  Print("dijkstra", width, vertices, queries, 0.0, dijkstra);
+  int wrong = 0;
+
+  {
+    typedef Astar<GridGraph, Euclid> Search;
+    Callback<GridGraph, Search> callback(graph);
+    Search astar(graph, callback);
+
+    Tally forward = RunAstar(astar, queries, Forward);
+    Print("astar_forward", width, vertices, queries, 0.0, forward);
+    Tally bidirectional = RunAstar(astar, queries, Bidirectional);
+    Print("astar_bidirectional", width, vertices, queries, 0.0, bidirectional);
+    wrong += forward.wrong + bidirectional.wrong;
+  }
+
+  {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    Landmarks<GridGraph> table(graph, vertices, landmarkCount, AvoidLandmarks, seed);
+    double preprocess = Since(start);
+
+    typedef LandmarkHeuristic<GridGraph> Heuristic;
+    typedef Astar<GridGraph, Heuristic> Search;
+    Heuristic heuristic(table);
+    Callback<GridGraph, Search> callback(graph);
+    Search astar(graph, callback, heuristic);
+
+    Tally forward = RunAstar(astar, queries, Forward);
+    Print("alt_forward", width, vertices, queries, preprocess, forward);
+    Tally bidirectional = RunAstar(astar, queries, Bidirectional);
+    Print("alt_bidirectional", width, vertices, queries, preprocess, bidirectional);
+    wrong += forward.wrong + bidirectional.wrong;
+  }
+
+  {
+    //quantised tables are admissible but not consistent, forward search only
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    Landmarks<GridGraph, uint16_t> table(graph, vertices, landmarkCount, AvoidLandmarks, seed);
+    double preprocess = Since(start);
+
+    typedef LandmarkHeuristic<GridGraph, uint16_t> Heuristic;
+    typedef Astar<GridGraph, Heuristic> Search;
+    Heuristic heuristic(table);
+    Callback<GridGraph, Search> callback(graph);
+    Search astar(graph, callback, heuristic);
+
+    Tally forward = RunAstar(astar, queries, Forward);
+    Print("alt16_forward", width, vertices, queries, preprocess, forward);
+    wrong += forward.wrong;
+  }
+
+  {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    ContractionHierarchy<GridGraph> hierarchy(graph, vertices);
+    double preprocess = Since(start);
+
+    Tally tally;
+    for (size_t i = 0; i < queries.size(); ++i)
+    {
+      std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+      std::vector<GridGraph::Edge> path = hierarchy.search(queries[i].start, queries[i].goal);
+      tally.seconds += Since(begin);
+      tally.settled += hierarchy.GetSettledCount();
+      tally.wrong += Agrees(path, queries[i]) ? 0 : 1;
+    }
+    Print("ch", width, vertices, queries, preprocess, tally);
+    std::cout << "# ch shortcuts " << hierarchy.GetShortcutCount() << std::endl;
+    wrong += tally.wrong;
+  }
+
+  return wrong ? 1 : 0;
+}
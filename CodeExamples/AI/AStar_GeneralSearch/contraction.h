@@ -0,0 +1,599 @@
+#ifndef CONTRACTION
+#define CONTRACTION
+#include <vector>
+#include <float.h>
+#include <algorithm>
+#include "indexed_heap.h"
+
+//Contraction hierarchies for static graphs with many queries
+//
+//The builder removes vertices one at a time, least important first, and adds
+//a shortcut u -> w for every path u -> v -> w through the removed vertex v
+//that is the only shortest one (no witness path around v is found by a short
+//local Dijkstra, limited in settled vertices and in hops). Importance is the
+//edge difference, shortcuts added minus edges removed, plus the number of
+//neighbours already removed and the depth in the hierarchy, so the
+//contraction spreads over the graph. The keys of v's neighbours follow once
+//v is removed, and the shortcuts a vertex needs are simulated again lazily
+//when it comes to the top of the queue.
+//
+//Every edge then points up in the order of removal, from the vertex removed
+//first. A query runs Dijkstra upwards from both ends over these edges, kept
+//in CSR arrays, and skips (stalls) vertices that a higher one already reaches
+//cheaper. Shortcuts remember the two edges they stand for, search unpacks
+//them and returns the graph's own edges like Astar::search does.
+//
+//The graph needs GetVertex and GetOutEdges, ids run from 0 to VertexCount,
+//and has to stay unchanged while the hierarchy is used.
+template <typename GraphType>
+class ContractionHierarchy
+{
+  //witness searches while evaluating a priority are cut shorter than the
+  //ones for the real contraction, a missed witness only costs a shortcut
+  static const size_t SimulateSettleLimit = 100;
+  static const unsigned SimulateHopLimit = 4;
+  static const unsigned HopLimit = 8;
+
+public:
+  ContractionHierarchy(GraphType const& _graph, size_t VertexCount, size_t WitnessLimit = 500) :
+    graph(_graph),
+    vertexCount(VertexCount),
+    witnessLimit(WitnessLimit),
+    shortcutCount(0),
+    arcs(),
+    upOffset(),
+    up(),
+    downOffset(),
+    down(),
+    forwardList(),
+    backwardList(),
+    forwardStates(),
+    backwardStates(),
+    generation(0),
+    settled(0),
+    solution()
+  {
+    Build();
+  }
+
+  size_t GetShortcutCount() const { return shortcutCount; }
+
+  //vertices taken off the queues by the last search
+  size_t GetSettledCount() const { return settled; }
+
+  std::vector<typename GraphType::Edge> search(size_t startID, size_t goalID)
+  {
+    solution.clear();
+    settled = 0;
+    forwardList.Clear();
+    backwardList.Clear();
+    if (++generation == 0)
+    {
+      for (size_t v = 0; v < vertexCount; ++v)
+      {
+        forwardStates[v].generation = 0;
+        backwardStates[v].generation = 0;
+      }
+      generation = 1;
+    }
+
+    Reach(forwardList, forwardStates, startID, 0.0f, size_t(-1));
+    Reach(backwardList, backwardStates, goalID, 0.0f, size_t(-1));
+
+    float best = FLT_MAX;
+    size_t meeting = size_t(-1);
+
+    while (true)
+    {
+      //a side is done once its queue can not beat the best meeting point
+      bool forwardOpen = !forwardList.Empty() && forwardList.Top().key < best;
+      bool backwardOpen = !backwardList.Empty() && backwardList.Top().key < best;
+      if (!forwardOpen && !backwardOpen)
+      {
+        break;
+      }
+
+      if (forwardOpen && (!backwardOpen || forwardList.Top().key <= backwardList.Top().key))
+      {
+        Settle(forwardList, forwardStates, backwardStates, upOffset, up, downOffset, down, best, meeting);
+      }
+      else
+      {
+        Settle(backwardList, backwardStates, forwardStates, downOffset, down, upOffset, up, best, meeting);
+      }
+    }
+
+    if (meeting != size_t(-1))
+    {
+      //start .. meeting, found walking back from the meeting point
+      std::vector<size_t> path;
+      for (size_t v = meeting; forwardStates[v].parentArc != size_t(-1); v = arcs[forwardStates[v].parentArc].source)
+      {
+        path.push_back(forwardStates[v].parentArc);
+      }
+      std::reverse(path.begin(), path.end());
+      for (size_t v = meeting; backwardStates[v].parentArc != size_t(-1); v = arcs[backwardStates[v].parentArc].target)
+      {
+        path.push_back(backwardStates[v].parentArc);
+      }
+
+      std::vector<size_t> stack;
+      for (size_t i = 0; i < path.size(); ++i)
+      {
+        Unpack(path[i], stack);
+      }
+    }
+
+    return solution;
+  }
+
+private:
+  //an edge of the graph, or a shortcut for first followed by second
+  struct Arc
+  {
+    size_t source;
+    size_t target;
+    float weight;
+    size_t first;       //index into the source's out edges for an original edge
+    size_t second;      //size_t(-1) for an original edge
+  };
+
+  //CSR and out list entry, the vertex at the other end is copied next to the weight
+  struct UpArc
+  {
+    size_t vertex;
+    float weight;
+    size_t arc;
+  };
+
+  struct QueryState
+  {
+    QueryState() : cost(0.0f), parentArc(-1), generation(0) {}
+
+    float cost;
+    size_t parentArc;
+    unsigned generation;
+  };
+
+  ////////////////////////////////////////////////////////////
+  //preprocessing
+
+  //out lists hold the out arcs with their target and weight next to the arc
+  //index, which is all a witness search reads, in lists only the index. Both
+  //lists only keep arcs between vertices not contracted yet.
+  typedef std::vector<std::vector<UpArc> > OutLists;
+  typedef std::vector<std::vector<size_t> > InLists;
+
+  void Build()
+  {
+    //parallel edges collapse into the cheapest, loops are dropped
+    OutLists out(vertexCount);
+    InLists in(vertexCount);
+    arcStamp.assign(vertexCount, 0);
+    arcTo.assign(vertexCount, 0);
+    stamp = 0;
+    indexedSource = size_t(-1);
+    for (size_t u = 0; u < vertexCount; ++u)
+    {
+      std::vector<typename GraphType::Edge> const& outedges = graph.GetOutEdges(graph.GetVertex(u));
+      for (size_t i = 0; i < outedges.size(); ++i)
+      {
+        Arc arc;
+        arc.source = u;
+        arc.target = outedges[i].GetID2();
+        arc.weight = outedges[i].GetWeight();
+        arc.first = i;
+        arc.second = size_t(-1);
+        if (arc.target != u)
+        {
+          AddArc(arc, out, in);
+        }
+      }
+    }
+
+    //shortcuts the last simulated contraction of a vertex needed
+    std::vector<int> added(vertexCount, 0);
+    std::vector<int> removedNeighbours(vertexCount, 0);
+    std::vector<int> depth(vertexCount, 0);
+    witnessStates.assign(vertexCount, QueryState());
+    witnessHops.assign(vertexCount, 0);
+    targetRound.assign(vertexCount, 0);
+    round = 0;
+
+    //upward arcs of every vertex, collected as it is contracted
+    std::vector<std::vector<UpArc> > upArcs(vertexCount), downArcs(vertexCount);
+
+    IndexedHeap<float> order;
+    order.Reserve(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+      added[v] = int(Contract(v, out, in, true));
+      order.Push(v, Priority(v, out, in, added, removedNeighbours, depth));
+    }
+
+    std::vector<size_t> neighbours;
+    while (!order.Empty())
+    {
+      size_t v = order.Top().id;
+      order.Pop();
+
+      //lazy update, the shortcuts v needs may have changed since it was simulated
+      added[v] = int(Contract(v, out, in, true));
+      float priority = Priority(v, out, in, added, removedNeighbours, depth);
+      if (!order.Empty() && priority > order.Top().key)
+      {
+        order.Push(v, priority);
+        continue;
+      }
+
+      Contract(v, out, in, false);
+
+      //the arcs left at v lead to the vertices contracted later
+      upArcs[v].swap(out[v]);
+      for (size_t i = 0; i < in[v].size(); ++i)
+      {
+        UpArc entry = { arcs[in[v][i]].source, arcs[in[v][i]].weight, in[v][i] };
+        downArcs[v].push_back(entry);
+      }
+      std::vector<size_t>().swap(in[v]);
+
+      //the neighbours forget their arcs to v
+      neighbours.clear();
+      for (size_t i = 0; i < upArcs[v].size(); ++i)
+      {
+        std::vector<size_t>& list = in[upArcs[v][i].vertex];
+        list.erase(std::find(list.begin(), list.end(), upArcs[v][i].arc));
+        ++removedNeighbours[upArcs[v][i].vertex];
+        neighbours.push_back(upArcs[v][i].vertex);
+      }
+      for (size_t i = 0; i < downArcs[v].size(); ++i)
+      {
+        std::vector<UpArc>& list = out[downArcs[v][i].vertex];
+        size_t j = 0;
+        while (list[j].arc != downArcs[v][i].arc)
+        {
+          ++j;
+        }
+        list.erase(list.begin() + j);
+        ++removedNeighbours[downArcs[v][i].vertex];
+        neighbours.push_back(downArcs[v][i].vertex);
+      }
+
+      //the neighbours lost their arcs to v, may have gained shortcuts and
+      //count one more removed neighbour, their keys follow right away. The
+      //shortcuts they need are only simulated again at the top of the queue,
+      //simulating every neighbour of every vertex costs more than it saves.
+      std::sort(neighbours.begin(), neighbours.end());
+      neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+      for (size_t i = 0; i < neighbours.size(); ++i)
+      {
+        depth[neighbours[i]] = std::max(depth[neighbours[i]], depth[v] + 1);
+        order.Update(neighbours[i], Priority(neighbours[i], out, in, added, removedNeighbours, depth));
+      }
+    }
+
+    ToCSR(upArcs, upOffset, up);
+    ToCSR(downArcs, downOffset, down);
+
+    std::vector<QueryState>().swap(witnessStates);
+    std::vector<unsigned>().swap(witnessHops);
+    std::vector<unsigned>().swap(targetRound);
+    std::vector<unsigned>().swap(arcStamp);
+    std::vector<size_t>().swap(arcTo);
+    witnessList = IndexedHeap<float>();
+    forwardStates.assign(vertexCount, QueryState());
+    backwardStates.assign(vertexCount, QueryState());
+    forwardList.Reserve(vertexCount);
+    backwardList.Reserve(vertexCount);
+  }
+
+  //adds arc unless an arc between the same vertices is as cheap, replaces a
+  //dearer one in place. Both ends are not contracted, so no shortcut refers
+  //to the replaced arc yet. Arcs come grouped by source, arcTo indexes the
+  //source's out list by target and is only rebuilt when the source changes.
+  void AddArc(Arc const& arc, OutLists& out, InLists& in)
+  {
+    std::vector<UpArc>& from = out[arc.source];
+    if (arc.source != indexedSource)
+    {
+      if (++stamp == 0)
+      {
+        std::fill(arcStamp.begin(), arcStamp.end(), 0u);
+        stamp = 1;
+      }
+      indexedSource = arc.source;
+      for (size_t i = 0; i < from.size(); ++i)
+      {
+        arcStamp[from[i].vertex] = stamp;
+        arcTo[from[i].vertex] = i;
+      }
+    }
+
+    size_t shortcut = arc.second != size_t(-1) ? 1 : 0;
+    if (arcStamp[arc.target] == stamp)
+    {
+      UpArc& entry = from[arcTo[arc.target]];
+      if (entry.weight > arc.weight)
+      {
+        shortcutCount += shortcut;
+        shortcutCount -= arcs[entry.arc].second != size_t(-1) ? 1 : 0;
+        arcs[entry.arc] = arc;
+        entry.weight = arc.weight;
+      }
+      return;
+    }
+
+    arcStamp[arc.target] = stamp;
+    arcTo[arc.target] = from.size();
+    UpArc entry = { arc.target, arc.weight, arcs.size() };
+    from.push_back(entry);
+    in[arc.target].push_back(arcs.size());
+    arcs.push_back(arc);
+    shortcutCount += shortcut;
+  }
+
+  //edge difference, weighted most, plus removed neighbours and the depth in
+  //the hierarchy so far, the last two spread the contraction over the graph
+  static float Priority(size_t v, OutLists const& out, InLists const& in, std::vector<int> const& added,
+    std::vector<int> const& removedNeighbours, std::vector<int> const& depth)
+  {
+    int removed = int(out[v].size() + in[v].size());
+    return float(4 * (added[v] - removed) + removedNeighbours[v] + 2 * depth[v]);
+  }
+
+  //shortcuts contracting v needs, added unless simulate is set
+  size_t Contract(size_t v, OutLists& out, InLists& in, bool simulate)
+  {
+    size_t shortcuts = 0;
+
+    //in and out are copied, adding shortcuts may grow the lists of v's neighbours
+    std::vector<size_t> inArcs(in[v]);
+    std::vector<UpArc> outArcs(out[v]);
+    //the arc index may be stale since arcs to contracted vertices were erased
+    indexedSource = size_t(-1);
+
+    //a witness search can stop once it has settled every target
+    if (++round == 0)
+    {
+      std::fill(targetRound.begin(), targetRound.end(), 0u);
+      round = 1;
+    }
+    float longest = 0.0f;
+    for (size_t j = 0; j < outArcs.size(); ++j)
+    {
+      targetRound[outArcs[j].vertex] = round;
+      longest = std::max(longest, outArcs[j].weight);
+    }
+
+    for (size_t i = 0; i < inArcs.size(); ++i)
+    {
+      Arc const inArc = arcs[inArcs[i]];
+      Witness(inArc.source, v, inArc.weight + longest, outArcs.size(),
+        simulate ? std::min(witnessLimit, size_t(SimulateSettleLimit)) : witnessLimit,
+        simulate ? SimulateHopLimit : HopLimit, out);
+
+      for (size_t j = 0; j < outArcs.size(); ++j)
+      {
+        size_t w = outArcs[j].vertex;
+        if (w == inArc.source)
+        {
+          continue;
+        }
+
+        float length = inArc.weight + outArcs[j].weight;
+        QueryState const& witness = witnessStates[w];
+        if (witness.generation == generation && witness.cost <= length)
+        {
+          continue;
+        }
+
+        ++shortcuts;
+        if (!simulate)
+        {
+          Arc shortcut;
+          shortcut.source = inArc.source;
+          shortcut.target = w;
+          shortcut.weight = length;
+          shortcut.first = inArcs[i];
+          shortcut.second = outArcs[j].arc;
+          AddArc(shortcut, out, in);
+        }
+      }
+    }
+
+    return shortcuts;
+  }
+
+  //Dijkstra from source around skipped, over vertices not contracted yet,
+  //until limit is passed, settleLimit vertices or all targets are settled;
+  //paths stop after hopLimit arcs
+  void Witness(size_t source, size_t skipped, float limit, size_t targets, size_t settleLimit, unsigned hopLimit,
+    OutLists const& out)
+  {
+    if (++generation == 0)
+    {
+      for (size_t v = 0; v < witnessStates.size(); ++v)
+      {
+        witnessStates[v].generation = 0;
+      }
+      generation = 1;
+    }
+
+    witnessList.Clear();
+    witnessStates[source].generation = generation;
+    witnessStates[source].cost = 0.0f;
+    witnessHops[source] = 0;
+    witnessList.Push(source, 0.0f);
+
+    size_t count = 0;
+    while (!witnessList.Empty() && count++ < settleLimit)
+    {
+      size_t u = witnessList.Top().id;
+      float cost = witnessList.Top().key;
+      witnessList.Pop();
+      if (cost > limit)
+      {
+        break;
+      }
+      if (targetRound[u] == round && --targets == 0)
+      {
+        break;
+      }
+      if (witnessHops[u] >= hopLimit)
+      {
+        continue;
+      }
+
+      std::vector<UpArc> const& arcsOut = out[u];
+      for (size_t i = 0; i < arcsOut.size(); ++i)
+      {
+        if (arcsOut[i].vertex == skipped)
+        {
+          continue;
+        }
+
+        QueryState& next = witnessStates[arcsOut[i].vertex];
+        float length = cost + arcsOut[i].weight;
+        if (next.generation != generation)
+        {
+          next.generation = generation;
+          next.cost = length;
+          witnessHops[arcsOut[i].vertex] = witnessHops[u] + 1;
+          witnessList.Push(arcsOut[i].vertex, length);
+        }
+        else if (length < next.cost)
+        {
+          next.cost = length;
+          witnessHops[arcsOut[i].vertex] = witnessHops[u] + 1;
+          witnessList.DecreaseKey(arcsOut[i].vertex, length);
+        }
+      }
+    }
+  }
+
+  static void ToCSR(std::vector<std::vector<UpArc> >& lists, std::vector<size_t>& offset, std::vector<UpArc>& entries)
+  {
+    offset.assign(lists.size() + 1, 0);
+    for (size_t v = 0; v < lists.size(); ++v)
+    {
+      offset[v + 1] = offset[v] + lists[v].size();
+    }
+
+    entries.clear();
+    entries.reserve(offset.back());
+    for (size_t v = 0; v < lists.size(); ++v)
+    {
+      entries.insert(entries.end(), lists[v].begin(), lists[v].end());
+      std::vector<UpArc>().swap(lists[v]);
+    }
+  }
+
+  ////////////////////////////////////////////////////////////
+  //query
+
+  void Reach(IndexedHeap<float>& list, std::vector<QueryState>& states, size_t v, float cost, size_t arc)
+  {
+    QueryState& state = states[v];
+    if (state.generation != generation)
+    {
+      state.generation = generation;
+      state.cost = cost;
+      state.parentArc = arc;
+      list.Push(v, cost);
+    }
+    else if (cost < state.cost)
+    {
+      state.cost = cost;
+      state.parentArc = arc;
+      list.DecreaseKey(v, cost);
+    }
+  }
+
+  //settles the top of list, relaxing its upward arcs unless a higher vertex
+  //reaches it cheaper over the arcs pointing the other way
+  void Settle(IndexedHeap<float>& list, std::vector<QueryState>& states, std::vector<QueryState> const& other,
+    std::vector<size_t> const& offset, std::vector<UpArc> const& arcsUp,
+    std::vector<size_t> const& stallOffset, std::vector<UpArc> const& stallArcs,
+    float& best, size_t& meeting)
+  {
+    size_t v = list.Top().id;
+    float cost = list.Top().key;
+    list.Pop();
+    ++settled;
+
+    if (other[v].generation == generation && cost + other[v].cost < best)
+    {
+      best = cost + other[v].cost;
+      meeting = v;
+    }
+
+    for (size_t i = stallOffset[v]; i < stallOffset[v + 1]; ++i)
+    {
+      QueryState const& higher = states[stallArcs[i].vertex];
+      if (higher.generation == generation && higher.cost + stallArcs[i].weight < cost)
+      {
+        return;
+      }
+    }
+
+    for (size_t i = offset[v]; i < offset[v + 1]; ++i)
+    {
+      Reach(list, states, arcsUp[i].vertex, cost + arcsUp[i].weight, arcsUp[i].arc);
+    }
+  }
+
+  //appends the graph edges arc stands for, in path order
+  void Unpack(size_t arc, std::vector<size_t>& stack)
+  {
+    stack.push_back(arc);
+    while (!stack.empty())
+    {
+      Arc const& top = arcs[stack.back()];
+      stack.pop_back();
+
+      if (top.second == size_t(-1))
+      {
+        solution.push_back(graph.GetOutEdges(graph.GetVertex(top.source))[top.first]);
+      }
+      else
+      {
+        stack.push_back(top.second);
+        stack.push_back(top.first);
+      }
+    }
+  }
+
+  GraphType const& graph;
+  size_t vertexCount;
+  size_t witnessLimit;
+  size_t shortcutCount;
+
+  std::vector<Arc> arcs;
+  //up holds arcs to higher vertices by their lower end, down holds arcs from
+  //higher vertices by their lower end, for the backward search
+  std::vector<size_t> upOffset;
+  std::vector<UpArc> up;
+  std::vector<size_t> downOffset;
+  std::vector<UpArc> down;
+
+  IndexedHeap<float> forwardList;
+  IndexedHeap<float> backwardList;
+  std::vector<QueryState> forwardStates;
+  std::vector<QueryState> backwardStates;
+  unsigned generation;
+  size_t settled;
+  std::vector<typename GraphType::Edge> solution;
+
+  //only used while building
+  IndexedHeap<float> witnessList;
+  std::vector<QueryState> witnessStates;
+  std::vector<unsigned> witnessHops;
+  std::vector<unsigned> targetRound;
+  unsigned round;
+  std::vector<unsigned> arcStamp;
+  std::vector<size_t> arcTo;
+  unsigned stamp;
+  size_t indexedSource;
+};
+
+#endif
@@ -0,0 +1,146 @@
+#ifndef INDEXED_HEAP
+#define INDEXED_HEAP
+#include <vector>
+#include <algorithm>
+
+//d-ary min heap of vertex ids with decrease key
+//
+//Every entry carries its key next to the id, so sifting compares keys without
+//a second lookup, and position[id] remembers where an id sits in the heap.
+//The heap does not know which ids it holds, the caller keeps that (Astar has
+//the InList status for it). Clear only forgets the entries, both arrays keep
+//their memory for the next search.
+template <typename Key, unsigned Arity = 4>
+class IndexedHeap
+{
+public:
+  struct Entry
+  {
+    Key key;
+    size_t id;
+  };
+
+  bool Empty() const { return heap.empty(); }
+  size_t Size() const { return heap.size(); }
+  void Clear() { heap.clear(); }
+
+  //ids below count need no growing later
+  void Reserve(size_t count)
+  {
+    if (position.size() < count)
+    {
+      position.resize(count);
+    }
+  }
+
+  Entry const& Top() const { return heap.front(); }
+
+  void Pop()
+  {
+    Entry last = heap.back();
+    heap.pop_back();
+    if (!heap.empty())
+    {
+      SiftDown(0, last);
+    }
+  }
+
+  //id must not be in the heap
+  void Push(size_t id, Key key)
+  {
+    if (id >= position.size())
+    {
+      position.resize(std::max(id + 1, position.size() * 2));
+    }
+
+    Entry entry;
+    entry.key = key;
+    entry.id = id;
+    heap.push_back(entry);
+    SiftUp(heap.size() - 1, entry);
+  }
+
+  //id must be in the heap and key no larger than its current one
+  void DecreaseKey(size_t id, Key key)
+  {
+    size_t i = position[id];
+    Entry entry = heap[i];
+    entry.key = key;
+    SiftUp(i, entry);
+  }
+
+  //id must be in the heap, key may be larger or smaller than its current one
+  void Update(size_t id, Key key)
+  {
+    size_t i = position[id];
+    Entry entry = heap[i];
+    bool up = key < entry.key;
+    entry.key = key;
+    if (up)
+    {
+      SiftUp(i, entry);
+    }
+    else
+    {
+      SiftDown(i, entry);
+    }
+  }
+
+private:
+  void Place(size_t i, Entry const& entry)
+  {
+    heap[i] = entry;
+    position[entry.id] = i;
+  }
+
+  void SiftUp(size_t i, Entry const& entry)
+  {
+    while (i > 0)
+    {
+      size_t parent = (i - 1) / Arity;
+      if (!(entry.key < heap[parent].key))
+      {
+        break;
+      }
+      Place(i, heap[parent]);
+      i = parent;
+    }
+    Place(i, entry);
+  }
+
+  void SiftDown(size_t i, Entry const& entry)
+  {
+    size_t size = heap.size();
+    while (true)
+    {
+      size_t first = i * Arity + 1;
+      if (first >= size)
+      {
+        break;
+      }
+
+      size_t last = std::min(first + Arity, size);
+      size_t best = first;
+      for (size_t child = first + 1; child < last; ++child)
+      {
+        if (heap[child].key < heap[best].key)
+        {
+          best = child;
+        }
+      }
+
+      if (!(heap[best].key < entry.key))
+      {
+        break;
+      }
+      Place(i, heap[best]);
+      i = best;
+    }
+    Place(i, entry);
+  }
+
+  std::vector<Entry> heap;
+  std::vector<size_t> position;
+};
+
+#endif
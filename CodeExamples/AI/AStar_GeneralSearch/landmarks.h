@@ -0,0 +1,429 @@
+#ifndef LANDMARKS
+#define LANDMARKS
+#include <vector>
+#include <float.h>
+#include <stdint.h>
+#include <limits>
+#include <random>
+#include <algorithm>
+#include "indexed_heap.h"
+
+//ALT (A*, landmarks, triangle inequality) preprocessing for Astar
+//
+//Landmarks runs Dijkstra from and to a few chosen vertices and keeps the
+//distances, for any two vertices a, b and landmark L the triangle inequality
+//gives d(a, b) >= d(L, b) - d(L, a) and d(a, b) >= d(a, L) - d(b, L); the
+//largest of these bounds is the heuristic. It only needs GetVertex and
+//GetOutEdges from the graph, edges into a vertex are collected once, and
+//Vertex::GetID() to find a vertex's row in the tables.
+//
+//Distance is float or uint16_t. With uint16_t every distance is stored as
+//floor(d / scale) and each bound gives up one step of scale, so the heuristic
+//stays admissible but is no longer exactly consistent: use it with the one
+//way search, which reopens vertices, and float tables with Bidirectional.
+enum LandmarkSelection
+{
+  //each new landmark is the vertex farthest from the ones picked so far
+  FarthestLandmarks = 0,
+  //Goldberg and Werneck: grow a shortest path tree from a random root and
+  //follow the subtree the current landmarks bound worst down to a leaf
+  AvoidLandmarks
+};
+
+template <typename GraphType, typename Distance = float>
+class Landmarks
+{
+public:
+  Landmarks(GraphType const& graph, size_t VertexCount, unsigned Count, LandmarkSelection Selection = FarthestLandmarks, unsigned Seed = 1) :
+    vertexCount(VertexCount),
+    count(0),
+    scale(1.0f),
+    landmarks(),
+    from(),
+    to(),
+    reverseOffset(),
+    reverseSource(),
+    reverseWeight(),
+    heap(),
+    distance(),
+    parent(),
+    order()
+  {
+    BuildReverse(graph);
+
+    std::vector<float> fromDistances, toDistances;
+    std::mt19937 rng(Seed);
+    Count = unsigned(std::min<size_t>(Count, vertexCount));
+
+    //first landmark is the vertex farthest from a random one
+    if (Count > 0)
+    {
+      size_t root = rng() % vertexCount;
+      Dijkstra(graph, root, true);
+      landmarks.push_back(Farthest(distance));
+    }
+
+    std::vector<float> nearest(vertexCount, FLT_MAX);
+    while (landmarks.size() < Count)
+    {
+      //tables of the landmarks so far are needed by both selections
+      size_t l = landmarks.size() - 1;
+      Dijkstra(graph, landmarks[l], true);
+      fromDistances.insert(fromDistances.end(), distance.begin(), distance.end());
+      Dijkstra(graph, landmarks[l], false);
+      toDistances.insert(toDistances.end(), distance.begin(), distance.end());
+
+      size_t next;
+      if (Selection == AvoidLandmarks)
+      {
+        next = Avoid(graph, rng() % vertexCount, fromDistances, toDistances);
+      }
+      else
+      {
+        for (size_t v = 0; v < vertexCount; ++v)
+        {
+          float d = std::min(fromDistances[l * vertexCount + v], toDistances[l * vertexCount + v]);
+          nearest[v] = std::min(nearest[v], d);
+        }
+        next = Farthest(nearest);
+      }
+
+      //a selection that repeats a landmark would repeat forever, stop with
+      //fewer than asked for, GetCount tells how many there are
+      if (std::find(landmarks.begin(), landmarks.end(), next) != landmarks.end())
+      {
+        break;
+      }
+      landmarks.push_back(next);
+    }
+
+    //tables of the last landmark
+    if (fromDistances.size() < landmarks.size() * vertexCount)
+    {
+      Dijkstra(graph, landmarks.back(), true);
+      fromDistances.insert(fromDistances.end(), distance.begin(), distance.end());
+      Dijkstra(graph, landmarks.back(), false);
+      toDistances.insert(toDistances.end(), distance.begin(), distance.end());
+    }
+
+    count = unsigned(landmarks.size());
+    if (std::numeric_limits<Distance>::is_integer)
+    {
+      float largest = std::max(Largest(fromDistances), Largest(toDistances));
+      //the top value marks unreachable vertices
+      scale = largest > 0.0f ? largest / float(Unreachable() - 1) : 1.0f;
+    }
+    Store(fromDistances, from);
+    Store(toDistances, to);
+
+    //only the tables are kept
+    std::vector<size_t>().swap(reverseOffset);
+    std::vector<size_t>().swap(reverseSource);
+    std::vector<float>().swap(reverseWeight);
+    std::vector<float>().swap(distance);
+    std::vector<size_t>().swap(parent);
+    std::vector<size_t>().swap(order);
+  }
+
+  //landmarks actually kept, fewer than Count when the selection ran out of
+  //new vertices or the graph is smaller
+  unsigned GetCount() const { return count; }
+  std::vector<size_t> const& GetLandmarks() const { return landmarks; }
+
+  //lower bound on the distance from a to b
+  float Estimate(size_t a, size_t b) const
+  {
+    //no landmarks, no bound (and the tables are empty)
+    if (count == 0)
+    {
+      return 0.0f;
+    }
+
+    Distance const* fromA = &from[a * count];
+    Distance const* fromB = &from[b * count];
+    Distance const* toA = &to[a * count];
+    Distance const* toB = &to[b * count];
+    const Distance unreachable = Unreachable();
+
+    Distance best = 0;
+    for (unsigned i = 0; i < count; ++i)
+    {
+      //d(L, b) - d(L, a)
+      if (fromB[i] != unreachable && fromA[i] < fromB[i])
+      {
+        best = std::max(best, Distance(fromB[i] - fromA[i]));
+      }
+      //d(a, L) - d(b, L)
+      if (toA[i] != unreachable && toB[i] < toA[i])
+      {
+        best = std::max(best, Distance(toA[i] - toB[i]));
+      }
+    }
+
+    return Bound(best);
+  }
+
+private:
+  static Distance Unreachable() { return std::numeric_limits<Distance>::max(); }
+
+  //a stored difference back to a distance, a quantised one loses a step
+  float Bound(Distance difference) const
+  {
+    if (std::numeric_limits<Distance>::is_integer)
+    {
+      return difference > 1 ? float(difference - 1) * scale : 0.0f;
+    }
+    return float(difference);
+  }
+
+  static float Largest(std::vector<float> const& distances)
+  {
+    float largest = 0.0f;
+    for (size_t i = 0; i < distances.size(); ++i)
+    {
+      if (distances[i] != FLT_MAX)
+      {
+        largest = std::max(largest, distances[i]);
+      }
+    }
+    return largest;
+  }
+
+  void Store(std::vector<float> const& distances, std::vector<Distance>& table)
+  {
+    //row per vertex, the landmarks of a vertex sit next to each other
+    table.assign(vertexCount * count, Unreachable());
+    for (unsigned l = 0; l < count; ++l)
+    {
+      for (size_t v = 0; v < vertexCount; ++v)
+      {
+        float d = distances[l * vertexCount + v];
+        if (d != FLT_MAX)
+        {
+          table[v * count + l] = std::numeric_limits<Distance>::is_integer ? Distance(d / scale) : Distance(d);
+        }
+      }
+    }
+  }
+
+  //edges into every vertex, as offsets into source and weight
+  void BuildReverse(GraphType const& graph)
+  {
+    reverseOffset.assign(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+      std::vector<typename GraphType::Edge> const& outedges = graph.GetOutEdges(graph.GetVertex(v));
+      for (size_t i = 0; i < outedges.size(); ++i)
+      {
+        ++reverseOffset[outedges[i].GetID2() + 1];
+      }
+    }
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+      reverseOffset[v + 1] += reverseOffset[v];
+    }
+
+    reverseSource.resize(reverseOffset[vertexCount]);
+    reverseWeight.resize(reverseOffset[vertexCount]);
+    std::vector<size_t> next(reverseOffset.begin(), reverseOffset.end() - 1);
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+      std::vector<typename GraphType::Edge> const& outedges = graph.GetOutEdges(graph.GetVertex(v));
+      for (size_t i = 0; i < outedges.size(); ++i)
+      {
+        size_t slot = next[outedges[i].GetID2()]++;
+        reverseSource[slot] = v;
+        reverseWeight[slot] = outedges[i].GetWeight();
+      }
+    }
+  }
+
+  //distances from source, or to it when forward is false, into distance;
+  //parent and the settling order are kept for the avoid selection
+  void Dijkstra(GraphType const& graph, size_t source, bool forward)
+  {
+    distance.assign(vertexCount, FLT_MAX);
+    parent.assign(vertexCount, size_t(-1));
+    order.clear();
+    heap.Clear();
+    heap.Reserve(vertexCount);
+
+    distance[source] = 0.0f;
+    parent[source] = source;
+    heap.Push(source, 0.0f);
+
+    while (!heap.Empty())
+    {
+      size_t id = heap.Top().id;
+      float d = heap.Top().key;
+      heap.Pop();
+      order.push_back(id);
+
+      if (forward)
+      {
+        std::vector<typename GraphType::Edge> const& outedges = graph.GetOutEdges(graph.GetVertex(id));
+        for (size_t i = 0; i < outedges.size(); ++i)
+        {
+          Relax(outedges[i].GetID2(), id, d + outedges[i].GetWeight());
+        }
+      }
+      else
+      {
+        for (size_t i = reverseOffset[id]; i < reverseOffset[id + 1]; ++i)
+        {
+          Relax(reverseSource[i], id, d + reverseWeight[i]);
+        }
+      }
+    }
+  }
+
+  void Relax(size_t next, size_t id, float d)
+  {
+    if (d < distance[next])
+    {
+      bool queued = distance[next] != FLT_MAX;
+      distance[next] = d;
+      parent[next] = id;
+      if (queued)
+      {
+        heap.DecreaseKey(next, d);
+      }
+      else
+      {
+        heap.Push(next, d);
+      }
+    }
+  }
+
+  //reachable vertex with the largest value
+  size_t Farthest(std::vector<float> const& values) const
+  {
+    size_t best = 0;
+    for (size_t v = 1; v < vertexCount; ++v)
+    {
+      if (values[v] != FLT_MAX && (values[best] == FLT_MAX || values[v] > values[best]))
+      {
+        best = v;
+      }
+    }
+    return best;
+  }
+
+  size_t Avoid(GraphType const& graph, size_t root, std::vector<float> const& fromDistances, std::vector<float> const& toDistances)
+  {
+    Dijkstra(graph, root, true);
+    size_t picked = fromDistances.size() / vertexCount;
+
+    //how much the current landmarks underestimate d(root, v)
+    std::vector<float> size(vertexCount, 0.0f);
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+      size_t v = order[i];
+      float bound = 0.0f;
+      for (size_t l = 0; l < picked; ++l)
+      {
+        float fr = fromDistances[l * vertexCount + root], fv = fromDistances[l * vertexCount + v];
+        float tr = toDistances[l * vertexCount + root], tv = toDistances[l * vertexCount + v];
+        if (fv != FLT_MAX && fr != FLT_MAX)
+        {
+          bound = std::max(bound, fv - fr);
+        }
+        if (tr != FLT_MAX && tv != FLT_MAX)
+        {
+          bound = std::max(bound, tr - tv);
+        }
+      }
+      size[v] = std::max(0.0f, distance[v] - bound);
+    }
+
+    //subtree sums in reverse settling order, a subtree holding a landmark is
+    //already covered and counts for nothing
+    std::vector<char> covered(vertexCount, 0);
+    for (size_t l = 0; l < landmarks.size(); ++l)
+    {
+      covered[landmarks[l]] = 1;
+    }
+    for (size_t i = order.size(); i-- > 1;)
+    {
+      size_t v = order[i];
+      if (covered[v])
+      {
+        size[v] = 0.0f;
+        covered[parent[v]] = 1;
+      }
+      size[parent[v]] += size[v];
+    }
+
+    //children of the tree, then down the largest subtree to a leaf
+    std::vector<size_t> childOffset(vertexCount + 1, 0);
+    for (size_t i = 1; i < order.size(); ++i)
+    {
+      ++childOffset[parent[order[i]] + 1];
+    }
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+      childOffset[v + 1] += childOffset[v];
+    }
+    std::vector<size_t> children(childOffset[vertexCount]);
+    std::vector<size_t> next(childOffset.begin(), childOffset.end() - 1);
+    for (size_t i = 1; i < order.size(); ++i)
+    {
+      children[next[parent[order[i]]]++] = order[i];
+    }
+
+    size_t v = root;
+    while (childOffset[v] != childOffset[v + 1])
+    {
+      size_t best = children[childOffset[v]];
+      for (size_t c = childOffset[v] + 1; c < childOffset[v + 1]; ++c)
+      {
+        if (size[children[c]] > size[best])
+        {
+          best = children[c];
+        }
+      }
+      if (size[best] <= 0.0f)
+      {
+        break;
+      }
+      v = best;
+    }
+    return v;
+  }
+
+  size_t vertexCount;
+  unsigned count;
+  float scale;
+  std::vector<size_t> landmarks;
+  std::vector<Distance> from;
+  std::vector<Distance> to;
+
+  //only used while building
+  std::vector<size_t> reverseOffset;
+  std::vector<size_t> reverseSource;
+  std::vector<float> reverseWeight;
+  IndexedHeap<float> heap;
+  std::vector<float> distance;
+  std::vector<size_t> parent;
+  std::vector<size_t> order;
+};
+
+//heuristic for Astar over a Landmarks table, pass it to the Astar constructor
+//that takes a heuristic; it has no default constructor, a search without the
+//table would quietly degrade to Dijkstra
+template <typename GraphType, typename Distance = float>
+class LandmarkHeuristic
+{
+public:
+  LandmarkHeuristic(Landmarks<GraphType, Distance> const& Table) : table(&Table) {}
+
+  float operator()(GraphType const&, typename GraphType::Vertex const& a, typename GraphType::Vertex const& b) const
+  {
+    return table->Estimate(a.GetID(), b.GetID());
+  }
+
+private:
+  Landmarks<GraphType, Distance> const* table;
+};
+
+#endif
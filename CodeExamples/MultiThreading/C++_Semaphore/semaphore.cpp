@@ -1,28 +1,207 @@
 #include "semaphore.h"
+#include <thread>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <ctime>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
-Semaphore::Semaphore(int Count) : count(Count)
+static inline void relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  _mm_pause();
+#else
+  std::this_thread::yield();
+#endif
+}
+
+//sleeps while word is 0, may return early for no reason,
+//timeout is only a hint to give up, nullptr sleeps until woken
+static void sleep_on(std::atomic<int>& word, const std::chrono::nanoseconds* timeout)
+{
+#ifdef __linux__
+  timespec time;
+  if (timeout)
+  {
+    time.tv_sec = time_t(timeout->count() / 1000000000);
+    time.tv_nsec = long(timeout->count() % 1000000000);
+  }
+  //std::atomic<int> is a plain int, the kernel compares it to 0 before sleeping
+  syscall(SYS_futex, reinterpret_cast<int*>(&word), FUTEX_WAIT_PRIVATE, 0, timeout ? &time : nullptr, nullptr, 0);
+#elif defined(__cpp_lib_atomic_wait)
+  //std::atomic::wait has no timeout, a timed waiter polls instead
+  if (timeout)
+  {
+    std::this_thread::yield();
+  }
+  else
+  {
+    word.wait(0);
+  }
+#else
+  (void)timeout;
+  std::this_thread::yield();
+#endif
+}
+
+static void wake(std::atomic<int>& word, int n)
+{
+#ifdef __linux__
+  syscall(SYS_futex, reinterpret_cast<int*>(&word), FUTEX_WAKE_PRIVATE, n, nullptr, nullptr, 0);
+#elif defined(__cpp_lib_atomic_wait)
+  if (n == 1)
+  {
+    word.notify_one();
+  }
+  else
+  {
+    word.notify_all();
+  }
+#else
+  (void)word;
+  (void)n;
+#endif
+}
+
+Semaphore::Semaphore(int Count, int Spins) : spins(Spins), count(Count), waiting(0)
 {}
 
+bool Semaphore::try_wait()
+{
+  int c = count.load();
+  while (c > 0)
+  {
+    if (count.compare_exchange_weak(c, c - 1, std::memory_order_acquire, std::memory_order_relaxed))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
 void Semaphore::wait()
 {
-  --count;
+  for (int i = 0; i < spins; ++i)
+  {
+    if (try_wait())
+    {
+      return;
+    }
+    relax();
+  }
+
+  park(nullptr);
+}
+
+bool Semaphore::wait_for(std::chrono::nanoseconds timeout)
+{
+  std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + timeout;
 
-  if (count < 0)
+  for (int i = 0; i < spins; ++i)
   {
-    std::unique_lock<std::mutex> lock(mutex);
+    if (try_wait())
+    {
+      return true;
+    }
+    relax();
+  }
+
+  return park(&deadline);
+}
 
-    do
+bool Semaphore::park(const std::chrono::steady_clock::time_point* deadline)
+{
+  //registered before count is read again, so a signal either leaves a token
+  //this thread sees or sees this thread and wakes it
+  waiting.fetch_add(1);
+
+  bool taken;
+  while (!(taken = try_wait()))
+  {
+    if (deadline)
     {
-      condition.wait(lock);
-    } while (waiting > 0);
+      std::chrono::nanoseconds left = *deadline - std::chrono::steady_clock::now();
+      if (left.count() <= 0)
+      {
+        break;
+      }
+      sleep_on(count, &left);
+    }
+    else
+    {
+      sleep_on(count, nullptr);
+    }
+  }
+
+  waiting.fetch_sub(1);
+  return taken;
+}
+
+void Semaphore::signal(int n)
+{
+  if (n <= 0)
+  {
+    return;
+  }
+
+  count.fetch_add(n);
+  if (waiting.load() > 0)
+  {
+    wake(count, n);
+  }
+}
+
+Latch::Latch(int Count) : remaining(Count), gate(0)
+{}
+
+void Latch::count_down(int n)
+{
+  //the call that takes the count to zero or past it opens the gate, later
+  //calls find it already at or below zero and leave it alone
+  int before = remaining.fetch_sub(n);
+  if (before > 0 && before - n <= 0)
+  {
+    gate.signal();
+  }
+}
 
-    ++waiting;
+void Latch::wait()
+{
+  if (remaining.load() <= 0)
+  {
+    return;
   }
+
+  gate.wait();
+  gate.signal();
+}
+
+void Latch::arrive_and_wait()
+{
+  count_down();
+  wait();
 }
 
-void Semaphore::signal()
+Barrier::Barrier(int Count) : count(Count), arrived(0), turnstile(0), turnstile2(0)
+{}
+
+void Barrier::arrive_and_wait()
 {
-  ++count;
-  --waiting;
-  condition.notify_one();
-}
\ No newline at end of file
+  //the last one in opens the first turnstile for everybody
+  if (arrived.fetch_add(1) + 1 == count)
+  {
+    turnstile.signal(count);
+  }
+  turnstile.wait();
+
+  //and the last one out the second
+  if (arrived.fetch_sub(1) - 1 == 0)
+  {
+    turnstile2.signal(count);
+  }
+  turnstile2.wait();
+}
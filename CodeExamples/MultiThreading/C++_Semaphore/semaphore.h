@@ -1,16 +1,60 @@
-#include <mutex>
-#include <condition_variable>
+#ifndef SEMAPHORE_H
+#define SEMAPHORE_H
 #include <atomic>
+#include <chrono>
 
+//Counting semaphore that spins for a while and then parks the thread
+//
+//count holds the free tokens and never goes below zero. A waiter first tries
+//to take a token with a compare exchange, spins a little when there is none,
+//and only then registers in waiting and sleeps on count (a futex on Linux,
+//std::atomic::wait elsewhere). signal only enters the kernel when somebody
+//is registered, so neither side makes a system call without contention.
 class Semaphore
 {
 public:
-  Semaphore(int Count = 0);
-	void wait();
-	void signal();
+  Semaphore(int Count = 0, int Spins = 100);
+  void wait();
+  void signal(int n = 1);
+  //takes a token if one is free, never blocks
+  bool try_wait();
+  //false when no token could be taken before the timeout ran out
+  bool wait_for(std::chrono::nanoseconds timeout);
 private:
+  bool park(const std::chrono::steady_clock::time_point* deadline);
+
+  const int spins;
   std::atomic<int> count;
   std::atomic<int> waiting;
-  std::mutex mutex;
-  std::condition_variable condition;
 };
+
+//single use count down latch, wait returns once count_down calls took Count to
+//zero or below
+class Latch
+{
+public:
+  Latch(int Count);
+  void count_down(int n = 1);
+  void wait();
+  void arrive_and_wait();
+private:
+  std::atomic<int> remaining;
+  //stays empty until the count hits zero, then each waiter passes the token on
+  Semaphore gate;
+};
+
+//reusable barrier for Count threads, two turnstiles so a fast thread can not
+//take a token of the round the others are still leaving
+class Barrier
+{
+public:
+  Barrier(int Count);
+  void arrive_and_wait();
+private:
+  const int count;
+  std::atomic<int> arrived;
+  Semaphore turnstile;
+  Semaphore turnstile2;
+};
+
+#endif
@@ -0,0 +1,427 @@
+//Benchmark for the synchronisation primitives the examples use: the futex
+//Semaphore and Barrier from semaphore.h, the mutex and condition variable
+//semaphore of quicksort.cpp, POSIX sem_t, the sem_t barrier of gol.cpp and the
+//SpinBarrier of GOL_SIMD/barrier.h
+//one CSV row is printed per benchmark, primitive and thread count, with context
+//switches (getrusage) and futex system calls (perf tracepoint) per operation
+//build: g++ -O2 -std=c++17 -pthread semaphore_bench.cpp semaphore.cpp -o semaphore_bench
+//usage: semaphore_bench [-b pingpong,pc,barrier] [-t 2,4,8] [-n operations]
+//thread counts above the number of cores run oversubscribed, the default list
+//goes up to four threads per core; futex counts need perf_event_paranoid <= 1
+//or CAP_PERFMON and are -1 when the tracepoint can not be opened
+#include "semaphore.h"
+#include "../GOL_SIMD/barrier.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <semaphore.h>
+#include <sys/resource.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+//the semaphore of quicksort.cpp, a count under a mutex and a condition variable
+class CondvarSemaphore
+{
+public:
+  CondvarSemaphore(int Count = 0) : mtx(), cv(), count(Count) {}
+
+  void signal()
+  {
+    std::unique_lock<std::mutex> lock(mtx);
+    count++;
+    cv.notify_one();
+  }
+  void wait()
+  {
+    std::unique_lock<std::mutex> lock(mtx);
+    while (count == 0)
+    {
+      cv.wait(lock);
+    }
+    count--;
+  }
+private:
+  std::mutex mtx;
+  std::condition_variable cv;
+  int count;
+};
+
+class PosixSemaphore
+{
+public:
+  PosixSemaphore(int Count = 0) { sem_init(&sem, 0, Count); }
+  ~PosixSemaphore() { sem_destroy(&sem); }
+
+  void signal() { sem_post(&sem); }
+  void wait() { while (sem_wait(&sem) != 0) {} }
+private:
+  sem_t sem;
+};
+
+//the two phase barrier of gol.cpp, a counter under a sem_t mutex and one
+//sem_t per phase that the last thread posts once per thread
+class PosixBarrier
+{
+public:
+  PosixBarrier(int Count) : count(Count), arrived(0)
+  {
+    sem_init(&mutex, 0, 1);
+    sem_init(&barrier, 0, 0);
+    sem_init(&barrier2, 0, 0);
+  }
+  ~PosixBarrier()
+  {
+    sem_destroy(&mutex);
+    sem_destroy(&barrier);
+    sem_destroy(&barrier2);
+  }
+
+  void arrive_and_wait()
+  {
+    sem_wait(&mutex);
+    if (++arrived == count)
+    {
+      for (int i = 0; i < count; i++)
+      {
+        sem_post(&barrier);
+      }
+    }
+    sem_post(&mutex);
+    sem_wait(&barrier);
+
+    sem_wait(&mutex);
+    if (--arrived == 0)
+    {
+      for (int i = 0; i < count; i++)
+      {
+        sem_post(&barrier2);
+      }
+    }
+    sem_post(&mutex);
+    sem_wait(&barrier2);
+  }
+private:
+  const int count;
+  int arrived;
+  sem_t mutex;
+  sem_t barrier;
+  sem_t barrier2;
+};
+
+class SpinBarrierAdapter
+{
+public:
+  SpinBarrierAdapter(int Count) : barrier(Count) {}
+  void arrive_and_wait() { barrier.wait(); }
+private:
+  SpinBarrier barrier;
+};
+
+//counts futex system calls of this process and every thread started after
+//Start, through the syscalls:sys_enter_futex tracepoint
+class FutexCounter
+{
+public:
+  FutexCounter() : fd(-1)
+  {
+#ifdef __linux__
+    const char* paths[] = {
+      "/sys/kernel/tracing/events/syscalls/sys_enter_futex/id",
+      "/sys/kernel/debug/tracing/events/syscalls/sys_enter_futex/id"
+    };
+    long long id = -1;
+    for (size_t i = 0; i < sizeof(paths) / sizeof(paths[0]) && id < 0; ++i)
+    {
+      std::ifstream file(paths[i]);
+      if (!(file >> id))
+      {
+        id = -1;
+      }
+    }
+    if (id < 0)
+    {
+      return;
+    }
+
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_TRACEPOINT;
+    attr.size = sizeof(attr);
+    attr.config = (unsigned long long)id;
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_hv = 1;
+    fd = int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+  }
+  ~FutexCounter()
+  {
+#ifdef __linux__
+    if (fd >= 0)
+    {
+      close(fd);
+    }
+#endif
+  }
+
+  void Start()
+  {
+#ifdef __linux__
+    if (fd >= 0)
+    {
+      ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+
+  //-1 when the counter is not available
+  long long Stop()
+  {
+#ifdef __linux__
+    if (fd >= 0)
+    {
+      ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+      long long value = 0;
+      if (read(fd, &value, sizeof(value)) == sizeof(value))
+      {
+        return value;
+      }
+    }
+#endif
+    return -1;
+  }
+
+private:
+  int fd;
+};
+
+long long ContextSwitches()
+{
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_nvcsw + usage.ru_nivcsw;
+}
+
+struct Measurement
+{
+  double seconds;
+  long long contextSwitches;
+  long long futexCalls;
+};
+
+//runs body(thread) on threads threads, thread creation is part of the
+//measurement but is small next to the operations
+template <typename Body>
+Measurement Measure(FutexCounter& futex, int threads, Body body)
+{
+  Measurement result;
+  long long switches = ContextSwitches();
+  futex.Start();
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t)
+  {
+    workers.push_back(std::thread(body, t));
+  }
+  for (size_t t = 0; t < workers.size(); ++t)
+  {
+    workers[t].join();
+  }
+
+  result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  result.futexCalls = futex.Stop();
+  result.contextSwitches = ContextSwitches() - switches;
+  return result;
+}
+
+void Print(const char* bench, const char* primitive, int threads, long long operations, const Measurement& m)
+{
+  unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+  std::cout << bench << ','
+    << primitive << ','
+    << threads << ','
+    << (unsigned(threads) > cores ? "yes" : "no") << ','
+    << operations << ','
+    << m.seconds << ','
+    << m.seconds * 1e9 / operations << ','
+    << double(m.contextSwitches) / operations << ','
+    << (m.futexCalls < 0 ? -1.0 : double(m.futexCalls) / operations) << std::endl;
+}
+
+//two threads hand a token back and forth, one operation is a round trip
+template <typename Sem>
+void PingPong(const char* name, FutexCounter& futex, long long rounds)
+{
+  Sem ping(0), pong(0);
+  Measurement m = Measure(futex, 2, [&ping, &pong, rounds](int thread)
+  {
+    for (long long i = 0; i < rounds; ++i)
+    {
+      if (thread == 0)
+      {
+        ping.signal();
+        pong.wait();
+      }
+      else
+      {
+        ping.wait();
+        pong.signal();
+      }
+    }
+  });
+  Print("pingpong", name, 2, rounds, m);
+}
+
+//half the threads produce into a bounded buffer of 64 slots, the other half
+//consume, only the two semaphores are exercised, one operation is one item
+template <typename Sem>
+void ProducerConsumer(const char* name, FutexCounter& futex, int threads, long long items)
+{
+  threads = std::max(2, threads);
+  int producers = threads / 2;
+  int consumers = threads - producers;
+  Sem slots(64), full(0);
+
+  Measurement m = Measure(futex, threads, [&slots, &full, producers, consumers, items](int thread)
+  {
+    if (thread < producers)
+    {
+      long long mine = items / producers + (thread < items % producers ? 1 : 0);
+      for (long long i = 0; i < mine; ++i)
+      {
+        slots.wait();
+        full.signal();
+      }
+    }
+    else
+    {
+      int c = thread - producers;
+      long long mine = items / consumers + (c < items % consumers ? 1 : 0);
+      for (long long i = 0; i < mine; ++i)
+      {
+        full.wait();
+        slots.signal();
+      }
+    }
+  });
+  Print("pc", name, threads, items, m);
+}
+
+//every thread passes the barrier rounds times, one operation is one round
+template <typename B>
+void BarrierRounds(const char* name, FutexCounter& futex, int threads, long long rounds)
+{
+  B barrier(threads);
+  Measurement m = Measure(futex, threads, [&barrier, rounds](int)
+  {
+    for (long long i = 0; i < rounds; ++i)
+    {
+      barrier.arrive_and_wait();
+    }
+  });
+  Print("barrier", name, threads, rounds, m);
+}
+
+std::vector<std::string> Split(const char* text)
+{
+  std::vector<std::string> items;
+  std::stringstream stream(text);
+  std::string item;
+  while (std::getline(stream, item, ','))
+  {
+    items.push_back(item);
+  }
+  return items;
+}
+
+int main(int argc, char** argv)
+{
+  std::vector<std::string> benches = Split("pingpong,pc,barrier");
+  std::vector<int> threads;
+  long long operations = 100000;
+
+  unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+  for (unsigned t = 2; t <= 4 * cores; t *= 2)
+  {
+    threads.push_back(int(t));
+  }
+  if (unsigned(threads.back()) < 4 * cores)
+  {
+    threads.push_back(int(4 * cores));
+  }
+
+  for (int i = 1; i + 1 < argc; i += 2)
+  {
+    if (!std::strcmp(argv[i], "-b")) benches = Split(argv[i + 1]);
+    else if (!std::strcmp(argv[i], "-n")) operations = std::max(1LL, std::atoll(argv[i + 1]));
+    else if (!std::strcmp(argv[i], "-t"))
+    {
+      std::vector<std::string> list = Split(argv[i + 1]);
+      threads.clear();
+      for (size_t t = 0; t < list.size(); ++t)
+      {
+        threads.push_back(std::max(1, std::atoi(list[t].c_str())));
+      }
+    }
+    else
+    {
+      std::cerr << "unknown option " << argv[i] << std::endl;
+      return 1;
+    }
+  }
+
+  FutexCounter futex;
+  std::cout << "bench,primitive,threads,oversubscribed,operations,seconds,ns_per_op,context_switches_per_op,futex_calls_per_op" << std::endl;
+
+  for (size_t b = 0; b < benches.size(); ++b)
+  {
+    const std::string& bench = benches[b];
+    if (bench == "pingpong")
+    {
+      PingPong<Semaphore>("futex", futex, operations);
+      PingPong<CondvarSemaphore>("condvar", futex, operations);
+      PingPong<PosixSemaphore>("sem_t", futex, operations);
+    }
+    else if (bench == "pc")
+    {
+      for (size_t t = 0; t < threads.size(); ++t)
+      {
+        ProducerConsumer<Semaphore>("futex", futex, threads[t], operations);
+        ProducerConsumer<CondvarSemaphore>("condvar", futex, threads[t], operations);
+        ProducerConsumer<PosixSemaphore>("sem_t", futex, threads[t], operations);
+      }
+    }
+    else if (bench == "barrier")
+    {
+      //a round costs every thread a pass, fewer rounds keep the big counts short
+      for (size_t t = 0; t < threads.size(); ++t)
+      {
+        long long rounds = std::max(1LL, operations / threads[t]);
+        BarrierRounds<Barrier>("futex", futex, threads[t], rounds);
+        BarrierRounds<PosixBarrier>("sem_t", futex, threads[t], rounds);
+        BarrierRounds<SpinBarrierAdapter>("spin", futex, threads[t], rounds);
+      }
+    }
+    else
+    {
+      std::cerr << "unknown benchmark " << bench << std::endl;
+    }
+  }
+
+  return 0;
+}
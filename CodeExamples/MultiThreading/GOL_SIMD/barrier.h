@@ -0,0 +1,69 @@
+#ifndef BARRIER_H
+#define BARRIER_H
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+//reusable sense reversing barrier
+//waiting threads spin for a while and then park on a condition variable,
+//the last thread to arrive flips the sense and only wakes parked threads
+class SpinBarrier
+{
+public:
+  SpinBarrier(int Count, int Spins = 4000) :
+    count(Count),
+    spins(Spins),
+    remaining(Count),
+    sense(false),
+    sleepers(0),
+    mutex(),
+    condition()
+  {}
+
+  void wait()
+  {
+    //sense can not flip before this thread arrives, so it is safe to read here
+    bool old = sense.load(std::memory_order_relaxed);
+
+    if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+      //last one in, reset for the next round and release everybody
+      remaining.store(count, std::memory_order_relaxed);
+      sense.store(!old);
+
+      if (sleepers.load() > 0)
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        condition.notify_all();
+      }
+      return;
+    }
+
+    for (int i = 0; i < spins; ++i)
+    {
+      if (sense.load(std::memory_order_acquire) != old)
+      {
+        return;
+      }
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    ++sleepers;
+    while (sense.load() == old)
+    {
+      condition.wait(lock);
+    }
+    --sleepers;
+  }
+
+private:
+  const int count;
+  const int spins;
+  std::atomic<int> remaining;
+  std::atomic<bool> sense;
+  std::atomic<int> sleepers;
+  std::mutex mutex;
+  std::condition_variable condition;
+};
+
+#endif
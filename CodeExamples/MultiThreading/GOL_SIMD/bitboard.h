@@ -0,0 +1,247 @@
+#ifndef BITBOARD_H
+#define BITBOARD_H
+#include <vector>
+#include <tuple>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+//Game of Life board packed 64 cells per word
+//every row has one dead padding word on each side and the board has one
+//dead padding row on top and bottom, so the kernels never need bounds checks
+//bit j of data word k in a row is column k * 64 + j
+class BitBoard
+{
+public:
+  BitBoard(int Width = 0, int Height = 0) :
+    width(Width),
+    height(Height),
+    wordsPerRow((Width + 63) / 64),
+    stride(wordsPerRow + 2),
+    tailMask(Width % 64 ? (uint64_t(1) << (Width % 64)) - 1 : ~uint64_t(0)),
+    words(size_t(stride) * (Height + 2), 0)
+  {}
+
+  //first data word of row y (0 based, padding excluded)
+  uint64_t* Row(int y) { return &words[size_t(y + 1) * stride + 1]; }
+  const uint64_t* Row(int y) const { return &words[size_t(y + 1) * stride + 1]; }
+
+  void Set(int y, int x)
+  {
+    Row(y)[x >> 6] |= uint64_t(1) << (x & 63);
+  }
+
+  bool Get(int y, int x) const
+  {
+    return (Row(y)[x >> 6] >> (x & 63)) & 1;
+  }
+
+  void Clear()
+  {
+    std::fill(words.begin(), words.end(), 0);
+  }
+
+  //coordinates are (row, column), same as the run() interface
+  void Load(const std::vector< std::tuple<int, int> >& population)
+  {
+    size_t size = population.size();
+    for (size_t i = 0; i < size; ++i)
+    {
+      Set(std::get<0>(population[i]), std::get<1>(population[i]));
+    }
+  }
+
+  //live cells in row major order
+  std::vector< std::tuple<int, int> > Live() const
+  {
+    std::vector< std::tuple<int, int> > live;
+    for (int y = 0; y < height; ++y)
+    {
+      const uint64_t* row = Row(y);
+      for (int k = 0; k < wordsPerRow; ++k)
+      {
+        uint64_t word = row[k];
+        while (word)
+        {
+          live.push_back(std::make_tuple(y, k * 64 + __builtin_ctzll(word)));
+          word &= word - 1;
+        }
+      }
+    }
+    return live;
+  }
+
+  //compute rows [rowBegin, rowEnd) of the next generation of src into dst
+  static void Step(const BitBoard& src, BitBoard& dst, int rowBegin, int rowEnd);
+
+  //compute words [wordBegin, wordEnd) of row y of the next generation
+  static void StepSpan(const BitBoard& src, BitBoard& dst, int y, int wordBegin, int wordEnd);
+
+  //name of the kernel selected at compile time
+  static const char* KernelName();
+
+  int width;
+  int height;
+  int wordsPerRow;
+  int stride;
+  uint64_t tailMask;
+  std::vector<uint64_t> words;
+};
+
+//the operations needed by the bit sliced adder, one struct per instruction set
+struct ScalarOps
+{
+  typedef uint64_t V;
+  enum { Lanes = 1 };
+  static V Load(const uint64_t* p) { return *p; }
+  static void Store(uint64_t* p, V v) { *p = v; }
+  static V And(V a, V b) { return a & b; }
+  static V Or(V a, V b) { return a | b; }
+  static V Xor(V a, V b) { return a ^ b; }
+  static V AndNot(V a, V b) { return ~a & b; }
+  static V Shl1(V a) { return a << 1; }
+  static V Shr1(V a) { return a >> 1; }
+  static V Shl63(V a) { return a << 63; }
+  static V Shr63(V a) { return a >> 63; }
+};
+
+#if defined(__SSE2__)
+struct SSE2Ops
+{
+  typedef __m128i V;
+  enum { Lanes = 2 };
+  static V Load(const uint64_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+  static void Store(uint64_t* p, V v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+  static V And(V a, V b) { return _mm_and_si128(a, b); }
+  static V Or(V a, V b) { return _mm_or_si128(a, b); }
+  static V Xor(V a, V b) { return _mm_xor_si128(a, b); }
+  static V AndNot(V a, V b) { return _mm_andnot_si128(a, b); }
+  static V Shl1(V a) { return _mm_slli_epi64(a, 1); }
+  static V Shr1(V a) { return _mm_srli_epi64(a, 1); }
+  static V Shl63(V a) { return _mm_slli_epi64(a, 63); }
+  static V Shr63(V a) { return _mm_srli_epi64(a, 63); }
+};
+#endif
+
+#if defined(__AVX2__)
+struct AVX2Ops
+{
+  typedef __m256i V;
+  enum { Lanes = 4 };
+  static V Load(const uint64_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+  static void Store(uint64_t* p, V v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+  static V And(V a, V b) { return _mm256_and_si256(a, b); }
+  static V Or(V a, V b) { return _mm256_or_si256(a, b); }
+  static V Xor(V a, V b) { return _mm256_xor_si256(a, b); }
+  static V AndNot(V a, V b) { return _mm256_andnot_si256(a, b); }
+  static V Shl1(V a) { return _mm256_slli_epi64(a, 1); }
+  static V Shr1(V a) { return _mm256_srli_epi64(a, 1); }
+  static V Shl63(V a) { return _mm256_slli_epi64(a, 63); }
+  static V Shr63(V a) { return _mm256_srli_epi64(a, 63); }
+};
+typedef AVX2Ops VectorOps;
+#elif defined(__SSE2__)
+typedef SSE2Ops VectorOps;
+#else
+typedef ScalarOps VectorOps;
+#endif
+
+//next state of Ops::Lanes words starting at p, rows are stride words apart
+template <typename Ops>
+inline typename Ops::V StepWords(const uint64_t* p, int stride)
+{
+  typedef typename Ops::V V;
+
+  const uint64_t* up = p - stride;
+  const uint64_t* down = p + stride;
+
+  //the 8 neighbours of every cell as whole words
+  //west neighbour of bit j is bit j - 1, carried in from the previous word
+  V upC = Ops::Load(up);
+  V upW = Ops::Or(Ops::Shl1(upC), Ops::Shr63(Ops::Load(up - 1)));
+  V upE = Ops::Or(Ops::Shr1(upC), Ops::Shl63(Ops::Load(up + 1)));
+  V self = Ops::Load(p);
+  V midW = Ops::Or(Ops::Shl1(self), Ops::Shr63(Ops::Load(p - 1)));
+  V midE = Ops::Or(Ops::Shr1(self), Ops::Shl63(Ops::Load(p + 1)));
+  V downC = Ops::Load(down);
+  V downW = Ops::Or(Ops::Shl1(downC), Ops::Shr63(Ops::Load(down - 1)));
+  V downE = Ops::Or(Ops::Shr1(downC), Ops::Shl63(Ops::Load(down + 1)));
+
+  //bit sliced adder tree, count is kept modulo 8
+  //(8 neighbours wraps to 0, which is a dead cell either way)
+  V t = Ops::Xor(upW, upC);
+  V s0a = Ops::Xor(t, upE);
+  V c0a = Ops::Or(Ops::And(upW, upC), Ops::And(upE, t));
+
+  t = Ops::Xor(midW, midE);
+  V s0b = Ops::Xor(t, downW);
+  V c0b = Ops::Or(Ops::And(midW, midE), Ops::And(downW, t));
+
+  V s0c = Ops::Xor(downC, downE);
+  V c0c = Ops::And(downC, downE);
+
+  t = Ops::Xor(s0a, s0b);
+  V ones = Ops::Xor(t, s0c);
+  V c1 = Ops::Or(Ops::And(s0a, s0b), Ops::And(s0c, t));
+
+  t = Ops::Xor(c0a, c0b);
+  V s2 = Ops::Xor(t, c0c);
+  V fours = Ops::Or(Ops::And(c0a, c0b), Ops::And(c0c, t));
+
+  V twos = Ops::Xor(s2, c1);
+  fours = Ops::Xor(fours, Ops::And(s2, c1));
+
+  //alive when count is 3, or count is 2 and the cell is alive
+  return Ops::AndNot(fours, Ops::And(twos, Ops::Or(ones, self)));
+}
+
+inline void BitBoard::StepSpan(const BitBoard& src, BitBoard& dst, int y, int wordBegin, int wordEnd)
+{
+  const uint64_t* in = src.Row(y);
+  uint64_t* out = dst.Row(y);
+  int stride = src.stride;
+  int k = wordBegin;
+
+  for (; k + VectorOps::Lanes <= wordEnd; k += VectorOps::Lanes)
+  {
+    VectorOps::Store(out + k, StepWords<VectorOps>(in + k, stride));
+  }
+
+  for (; k < wordEnd; ++k)
+  {
+    out[k] = StepWords<ScalarOps>(in + k, stride);
+  }
+
+  //columns past the right edge must stay dead
+  if (wordBegin < wordEnd && wordEnd == src.wordsPerRow)
+  {
+    out[wordEnd - 1] &= src.tailMask;
+  }
+}
+
+inline void BitBoard::Step(const BitBoard& src, BitBoard& dst, int rowBegin, int rowEnd)
+{
+  for (int y = rowBegin; y < rowEnd; ++y)
+  {
+    StepSpan(src, dst, y, 0, src.wordsPerRow);
+  }
+}
+
+inline const char* BitBoard::KernelName()
+{
+#if defined(__AVX2__)
+  return "avx2";
+#elif defined(__SSE2__)
+  return "sse2";
+#else
+  return "scalar";
+#endif
+}
+
+#endif
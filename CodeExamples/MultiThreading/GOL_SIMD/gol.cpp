@@ -1,7 +1,11 @@
 #include "gol.h"
+#include "bitboard.h"
+#include "barrier.h"
 #include <pthread.h>
 #include <iostream>
 #include <semaphore.h>
+#include <thread>
+#include <chrono>
 
 typedef struct Parameters
 {
@@ -17,6 +21,24 @@ sem_t barrier;
 sem_t barrier2;
 sem_t mutex;
 
+//per generation timing, optional
+GolStats* cellStats;
+long long lastGeneration;
+
+long long NowNanos()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//the next generation is timed from after the push_back, so recording is
+//not counted in it
+void RecordGeneration(GolStats* stats, long long& last)
+{
+  long long now = NowNanos();
+  stats->generationNanos.push_back(now - last);
+  last = NowNanos();
+}
+
 void* UpdateCell(void* arguments)
 {
   //static variable is shared
@@ -92,6 +114,11 @@ void* UpdateCell(void* arguments)
     //block barrier and unlock barrier2
     if (Count == 0)
     {
+     if (cellStats)
+     {
+       RecordGeneration(cellStats, lastGeneration);
+     }
+
      for (int i = 0; i < max; i++)
      {
        sem_post(&barrier2);
@@ -105,7 +132,7 @@ void* UpdateCell(void* arguments)
   pthread_exit(NULL);
 }
 
-std::vector< std::tuple<int, int> > run(std::vector< std::tuple<int, int> > initial_population, int num_iter, int max_x, int max_y)
+std::vector< std::tuple<int, int> > run_cell_threads(std::vector< std::tuple<int, int> > initial_population, int num_iter, int max_x, int max_y, GolStats* stats)
 {
   std::vector<std::vector<bool>> mapData(max_y + 2, std::vector<bool>(max_x + 2, false));
   map = &mapData;
@@ -126,6 +153,9 @@ std::vector< std::tuple<int, int> > run(std::vector< std::tuple<int, int> > init
     mapData[std::get<0>(coord) + 1][std::get<1>(coord) + 1] = true;
   }
 
+  cellStats = stats;
+  lastGeneration = NowNanos();
+
   //create threads
   int count = 0;
   for (int y = 1; y <= max_y; ++y)
@@ -165,4 +195,230 @@ std::vector< std::tuple<int, int> > run(std::vector< std::tuple<int, int> > init
   delete[] threads;
   delete[] parameters;
   return live;
-}
\ No newline at end of file
+}
+
+std::vector< std::tuple<int, int> > run_simd(std::vector< std::tuple<int, int> > initial_population, int num_iter, int max_x, int max_y, GolStats* stats)
+{
+  //two boards, each generation reads one and writes the other
+  BitBoard boards[2] = { BitBoard(max_x, max_y), BitBoard(max_x, max_y) };
+  boards[0].Load(initial_population);
+
+  long long last = NowNanos();
+  int current = 0;
+  for (int i = 0; i < num_iter; ++i)
+  {
+    BitBoard::Step(boards[current], boards[current ^ 1], 0, max_y);
+    current ^= 1;
+
+    if (stats)
+    {
+      RecordGeneration(stats, last);
+    }
+  }
+
+  return boards[current].Live();
+}
+
+//one horizontal band of the board, owned by a single pool worker
+typedef struct Band
+{
+  int begin;
+  int end;
+}Band;
+
+//stats is only passed to one worker, it times the generations after the barrier
+void UpdateBand(BitBoard* boards, Band band, int num_iter, SpinBarrier* generation, GolStats* stats)
+{
+  long long last = NowNanos();
+  int current = 0;
+  for (int i = 0; i < num_iter; ++i)
+  {
+    //boards are double buffered, so reading the old generation and writing
+    //the new one need no barrier in between, only one per generation
+    BitBoard::Step(boards[current], boards[current ^ 1], band.begin, band.end);
+    current ^= 1;
+    generation->wait();
+
+    if (stats)
+    {
+      RecordGeneration(stats, last);
+    }
+  }
+}
+
+std::vector< std::tuple<int, int> > run_pool(std::vector< std::tuple<int, int> > initial_population, int num_iter, int max_x, int max_y, int num_threads, GolStats* stats)
+{
+  if (num_threads <= 0)
+  {
+    num_threads = int(std::thread::hardware_concurrency());
+  }
+
+  //at least one row per worker
+  if (num_threads > max_y)
+  {
+    num_threads = max_y;
+  }
+
+  if (num_threads < 1)
+  {
+    num_threads = 1;
+  }
+
+  BitBoard boards[2] = { BitBoard(max_x, max_y), BitBoard(max_x, max_y) };
+  boards[0].Load(initial_population);
+
+  SpinBarrier generation(num_threads);
+  std::thread* threads = new std::thread[num_threads]();
+
+  //split rows evenly, the first bands take one extra row each
+  int rows = max_y / num_threads;
+  int extra = max_y % num_threads;
+  int begin = 0;
+  for (int i = 0; i < num_threads; ++i)
+  {
+    Band band;
+    band.begin = begin;
+    band.end = begin + rows + (i < extra ? 1 : 0);
+    begin = band.end;
+
+    threads[i] = std::thread(UpdateBand, boards, band, num_iter, &generation, i == 0 ? stats : nullptr);
+  }
+
+  for (int i = 0; i < num_threads; ++i)
+  {
+    threads[i].join();
+  }
+
+  delete[] threads;
+  return boards[num_iter & 1].Live();
+}
+
+//tiles are one word (64 columns) wide and 64 rows high
+const int TileRows = 64;
+
+std::vector< std::tuple<int, int> > run_tracked(std::vector< std::tuple<int, int> > initial_population, int num_iter, int max_x, int max_y, GolStats* stats)
+{
+  BitBoard boards[2] = { BitBoard(max_x, max_y), BitBoard(max_x, max_y) };
+  boards[0].Load(initial_population);
+
+  int tilesX = boards[0].wordsPerRow;
+  int tilesY = (max_y + TileRows - 1) / TileRows;
+  size_t tiles = size_t(tilesX) * tilesY;
+
+  //dirty tile maps for the previous generation: content changed, content not empty
+  //every tile with live cells counts as changed at the start, empty tiles hold
+  //the same (empty) content in both boards so they can be skipped right away
+  std::vector<unsigned char> changed(tiles, 0), nextChanged(tiles, 0);
+  std::vector<unsigned char> live(tiles, 0), nextLive(tiles, 0);
+
+  for (int ty = 0; ty < tilesY; ++ty)
+  {
+    int rowEnd = std::min(max_y, (ty + 1) * TileRows);
+    for (int tx = 0; tx < tilesX; ++tx)
+    {
+      for (int y = ty * TileRows; y < rowEnd; ++y)
+      {
+        if (boards[0].Row(y)[tx])
+        {
+          changed[ty * tilesX + tx] = live[ty * tilesX + tx] = 1;
+          break;
+        }
+      }
+    }
+  }
+
+  if (stats)
+  {
+    stats->tilesX = tilesX;
+    stats->tilesY = tilesY;
+    stats->tilesEvaluated.clear();
+  }
+
+  long long last = NowNanos();
+  int current = 0;
+  for (int i = 0; i < num_iter; ++i)
+  {
+    BitBoard& src = boards[current];
+    BitBoard& dst = boards[current ^ 1];
+    int evaluated = 0;
+
+    for (int ty = 0; ty < tilesY; ++ty)
+    {
+      int rowBegin = ty * TileRows;
+      int rowEnd = std::min(max_y, rowBegin + TileRows);
+
+      for (int tx = 0; tx < tilesX; ++tx)
+      {
+        size_t tile = size_t(ty) * tilesX + tx;
+
+        //look at the 3x3 block of tiles around this one
+        bool dirty = false;
+        bool populated = false;
+        for (int ny = std::max(ty - 1, 0); ny <= std::min(ty + 1, tilesY - 1); ++ny)
+        {
+          for (int nx = std::max(tx - 1, 0); nx <= std::min(tx + 1, tilesX - 1); ++nx)
+          {
+            dirty |= changed[size_t(ny) * tilesX + nx] != 0;
+            populated |= live[size_t(ny) * tilesX + nx] != 0;
+          }
+        }
+
+        //nothing around changed, the tile is stable and dst already holds
+        //the same content because the tile itself did not change either
+        if (!dirty)
+        {
+          nextChanged[tile] = 0;
+          nextLive[tile] = live[tile];
+          continue;
+        }
+
+        //everything around is dead, so the tile stays dead; dst still holds
+        //the generation before this one, clear it if the tile just died out
+        if (!populated)
+        {
+          if (changed[tile])
+          {
+            for (int y = rowBegin; y < rowEnd; ++y)
+            {
+              dst.Row(y)[tx] = 0;
+            }
+          }
+
+          nextChanged[tile] = 0;
+          nextLive[tile] = 0;
+          continue;
+        }
+
+        ++evaluated;
+        uint64_t difference = 0;
+        uint64_t any = 0;
+        for (int y = rowBegin; y < rowEnd; ++y)
+        {
+          BitBoard::StepSpan(src, dst, y, tx, tx + 1);
+          difference |= dst.Row(y)[tx] ^ src.Row(y)[tx];
+          any |= dst.Row(y)[tx];
+        }
+
+        nextChanged[tile] = difference != 0;
+        nextLive[tile] = any != 0;
+      }
+    }
+
+    if (stats)
+    {
+      stats->tilesEvaluated.push_back(evaluated);
+      RecordGeneration(stats, last);
+    }
+
+    changed.swap(nextChanged);
+    live.swap(nextLive);
+    current ^= 1;
+  }
+
+  return boards[current].Live();
+}
+
+std::vector< std::tuple<int, int> > run(std::vector< std::tuple<int, int> > initial_population, int num_iter, int max_x, int max_y)
+{
+  return run_simd(initial_population, num_iter, max_x, max_y);
+}
\ No newline at end of file
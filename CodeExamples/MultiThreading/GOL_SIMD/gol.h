@@ -2,7 +2,46 @@
 #define GOL_H
 #include <vector>
 #include <tuple>
+#include <cstddef>
+
+//counters filled in by the engines that support them
+struct GolStats
+{
+  int tilesX;                         //tile grid of run_tracked
+  int tilesY;
+  std::vector<int> tilesEvaluated;    //tiles recomputed, one entry per generation
+  std::vector<long long> generationNanos; //wall time of every generation
+};
 
 std::vector< std::tuple<int,int> > // return vector of coordinates of the alive cells of the final population
 run( std::vector< std::tuple<int,int> > initial_population, int num_iter, int max_x, int max_y );
+
+//engines behind run(), all take the same arguments and return the same ordering (row major)
+
+//one pthread per cell, generations separated by semaphore barriers
+std::vector< std::tuple<int,int> >
+run_cell_threads( std::vector< std::tuple<int,int> > initial_population, int num_iter, int max_x, int max_y, GolStats* stats = nullptr );
+
+//single thread, 64 cells per word, neighbour counts with bit sliced adders
+//(AVX2 or SSE2 kernel when the compiler targets it, scalar otherwise)
+std::vector< std::tuple<int,int> >
+run_simd( std::vector< std::tuple<int,int> > initial_population, int num_iter, int max_x, int max_y, GolStats* stats = nullptr );
+
+//fixed pool of num_threads workers (0 = hardware concurrency), each owning a
+//band of rows, stepping the bit packed board with one barrier per generation
+std::vector< std::tuple<int,int> >
+run_pool( std::vector< std::tuple<int,int> > initial_population, int num_iter, int max_x, int max_y, int num_threads = 0, GolStats* stats = nullptr );
+
+//single thread, bit packed board split into 64x64 tiles; a tile is only
+//recomputed when it or a neighbour changed in the previous generation
+std::vector< std::tuple<int,int> >
+run_tracked( std::vector< std::tuple<int,int> > initial_population, int num_iter, int max_x, int max_y, GolStats* stats = nullptr );
+
+//HashLife (memoised quadtree) on an unbounded plane, there is no board so
+//cells that reach the edges of a max_x by max_y board keep going instead of
+//dying; num_iter may be in the billions, max_memory caps the node cache
+//(advisory, see HashLife); a pattern that outgrows a 2^62 square stops the
+//run early and cells outside the int range are not returned
+std::vector< std::tuple<int,int> >
+run_hashlife( std::vector< std::tuple<int,int> > initial_population, unsigned long long num_iter, size_t max_memory = size_t(256) << 20 );
 #endif
@@ -0,0 +1,296 @@
+//Game of Life benchmark, runs every engine over a grid of patterns, board
+//sizes and iteration counts and prints one CSV row per run
+//build: g++ -O2 -march=native -pthread gol_bench.cpp gol.cpp hashlife.cpp -o gol_bench
+//usage: gol_bench [-s 64,256,1024] [-i 10,100] [-t 1,2,4,8] [-r repeats] [-c max_cells_for_cell_threads]
+//the line starting with # above the CSV header is a note, not a row
+#include "gol.h"
+#include "bitboard.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <tuple>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <sys/resource.h>
+
+typedef std::vector< std::tuple<int, int> > Population;
+
+struct Options
+{
+  std::vector<int> sizes;
+  std::vector<int> iterations;
+  std::vector<int> threads;
+  int repeats;
+  long long maxCellThreads;   //run_cell_threads starts one thread per cell, keep it small;
+                              //only boards up to this many cells get a cell_threads row
+};
+
+std::vector<int> ParseList(const char* text)
+{
+  std::vector<int> values;
+  std::stringstream stream(text);
+  std::string item;
+  while (std::getline(stream, item, ','))
+  {
+    values.push_back(std::atoi(item.c_str()));
+  }
+  return values;
+}
+
+//known patterns are placed in the middle of the board, random soups are
+//seeded from the board size so every run sees the same cells
+Population MakePattern(const std::string& name, int width, int height)
+{
+  Population population;
+  int cy = height / 2;
+  int cx = width / 2;
+
+  if (name == "glider")
+  {
+    int cells[5][2] = { { 0, 1 }, { 1, 2 }, { 2, 0 }, { 2, 1 }, { 2, 2 } };
+    for (int i = 0; i < 5; ++i)
+    {
+      population.push_back(std::make_tuple(cy + cells[i][0], cx + cells[i][1]));
+    }
+  }
+  else if (name == "rpentomino")
+  {
+    int cells[5][2] = { { 0, 1 }, { 0, 2 }, { 1, 0 }, { 1, 1 }, { 2, 1 } };
+    for (int i = 0; i < 5; ++i)
+    {
+      population.push_back(std::make_tuple(cy + cells[i][0], cx + cells[i][1]));
+    }
+  }
+  else
+  {
+    int percent = name == "random10" ? 10 : 50;
+    std::mt19937 rng(unsigned(width * 7919 + height));
+    for (int y = 0; y < height; ++y)
+    {
+      for (int x = 0; x < width; ++x)
+      {
+        if (int(rng() % 100) < percent)
+        {
+          population.push_back(std::make_tuple(y, x));
+        }
+      }
+    }
+  }
+
+  return population;
+}
+
+//reset the peak RSS counter of this process (Linux 4.0+), false if not supported
+bool ResetPeakRSS()
+{
+  std::ofstream clear("/proc/self/clear_refs");
+  if (!clear)
+  {
+    return false;
+  }
+  clear << "5";
+  return bool(clear);
+}
+
+//peak RSS in kB since the last reset, or since start when resetting failed
+long PeakRSS()
+{
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line))
+  {
+    if (line.compare(0, 6, "VmHWM:") == 0)
+    {
+      return std::atol(line.c_str() + 6);
+    }
+  }
+
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+double Percentile(std::vector<long long> values, double p)
+{
+  if (values.empty())
+  {
+    return 0.0;
+  }
+
+  std::sort(values.begin(), values.end());
+  size_t index = std::min(values.size() - 1, size_t(p * (values.size() - 1) + 0.5));
+  return values[index] / 1000.0;
+}
+
+//hashlife has no board edges, only compare it when the pattern stayed clear of them
+bool TouchesEdge(const Population& population, int width, int height)
+{
+  size_t size = population.size();
+  for (size_t i = 0; i < size; ++i)
+  {
+    int y = std::get<0>(population[i]);
+    int x = std::get<1>(population[i]);
+    if (y <= 0 || x <= 0 || y >= height - 1 || x >= width - 1)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+struct Result
+{
+  double seconds;
+  long peakRSS;
+  std::vector<long long> generationNanos;
+  Population live;
+};
+
+Result Measure(const std::string& engine, int threads, const Population& population, int iterations, int width, int height)
+{
+  Result result;
+  GolStats stats;
+  //recording a generation must not allocate inside the timed region
+  stats.generationNanos.reserve(iterations);
+  stats.tilesEvaluated.reserve(iterations);
+  ResetPeakRSS();
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  if (engine == "cell_threads")
+  {
+    result.live = run_cell_threads(population, iterations, width, height, &stats);
+  }
+  else if (engine == "simd")
+  {
+    result.live = run_simd(population, iterations, width, height, &stats);
+  }
+  else if (engine == "pool")
+  {
+    result.live = run_pool(population, iterations, width, height, threads, &stats);
+  }
+  else if (engine == "tracked")
+  {
+    result.live = run_tracked(population, iterations, width, height, &stats);
+  }
+  else
+  {
+    result.live = run_hashlife(population, (unsigned long long)iterations);
+  }
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+  result.seconds = std::chrono::duration<double>(end - start).count();
+  result.peakRSS = PeakRSS();
+  result.generationNanos.swap(stats.generationNanos);
+  return result;
+}
+
+int main(int argc, char** argv)
+{
+  Options options;
+  options.sizes = ParseList("32,64,256,1024,4096");
+  options.iterations = ParseList("10,100,1000");
+  options.threads = ParseList("1,2,4,8");
+  options.repeats = 3;
+  options.maxCellThreads = 1024;
+
+  for (int i = 1; i + 1 < argc; i += 2)
+  {
+    if (!std::strcmp(argv[i], "-s")) options.sizes = ParseList(argv[i + 1]);
+    else if (!std::strcmp(argv[i], "-i")) options.iterations = ParseList(argv[i + 1]);
+    else if (!std::strcmp(argv[i], "-t")) options.threads = ParseList(argv[i + 1]);
+    else if (!std::strcmp(argv[i], "-r")) options.repeats = std::max(1, std::atoi(argv[i + 1]));
+    else if (!std::strcmp(argv[i], "-c")) options.maxCellThreads = std::atoll(argv[i + 1]);
+    else
+    {
+      std::cerr << "unknown option " << argv[i] << std::endl;
+      return 1;
+    }
+  }
+
+  const char* patterns[] = { "glider", "rpentomino", "random10", "random50" };
+
+  std::cout << "# hashlife advances in power of two steps and has no per generation time, its gen_* columns are empty" << std::endl;
+  std::cout << "engine,kernel,threads,pattern,width,height,iterations,repeat,seconds,cells_per_sec,"
+    "gen_p50_us,gen_p90_us,gen_p99_us,peak_rss_kb,match" << std::endl;
+
+  for (size_t s = 0; s < options.sizes.size(); ++s)
+  {
+    int size = options.sizes[s];
+    for (size_t p = 0; p < sizeof(patterns) / sizeof(patterns[0]); ++p)
+    {
+      Population population = MakePattern(patterns[p], size, size);
+
+      for (size_t it = 0; it < options.iterations.size(); ++it)
+      {
+        int iterations = options.iterations[it];
+
+        //engine and thread count pairs for this board
+        std::vector< std::pair<std::string, int> > runs;
+        runs.push_back(std::make_pair(std::string("simd"), 1));
+        if ((long long)size * size <= options.maxCellThreads)
+        {
+          runs.push_back(std::make_pair(std::string("cell_threads"), size * size));
+        }
+        for (size_t t = 0; t < options.threads.size(); ++t)
+        {
+          runs.push_back(std::make_pair(std::string("pool"), options.threads[t]));
+        }
+        runs.push_back(std::make_pair(std::string("tracked"), 1));
+        runs.push_back(std::make_pair(std::string("hashlife"), 1));
+
+        //simd is the reference every other engine is checked against
+        Population reference;
+
+        for (size_t r = 0; r < runs.size(); ++r)
+        {
+          for (int repeat = 0; repeat < options.repeats; ++repeat)
+          {
+            Result result = Measure(runs[r].first, runs[r].second, population, iterations, size, size);
+
+            if (r == 0 && repeat == 0)
+            {
+              reference = result.live;
+            }
+
+            const char* match = result.live == reference ? "yes" : "no";
+            if (runs[r].first == "hashlife" && result.live != reference &&
+              (TouchesEdge(reference, size, size) || TouchesEdge(result.live, size, size)))
+            {
+              match = "edge";
+            }
+
+            double cells = double(size) * size * iterations;
+            std::cout << runs[r].first << ','
+              << BitBoard::KernelName() << ','
+              << runs[r].second << ','
+              << patterns[p] << ','
+              << size << ',' << size << ','
+              << iterations << ','
+              << repeat << ','
+              << result.seconds << ','
+              << (result.seconds > 0.0 ? cells / result.seconds : 0.0) << ',';
+            if (result.generationNanos.empty())
+            {
+              std::cout << ",,,";
+            }
+            else
+            {
+              std::cout << Percentile(result.generationNanos, 0.50) << ','
+                << Percentile(result.generationNanos, 0.90) << ','
+                << Percentile(result.generationNanos, 0.99) << ',';
+            }
+            std::cout << result.peakRSS << ','
+              << match << std::endl;
+          }
+        }
+      }
+    }
+  }
+
+  return 0;
+}
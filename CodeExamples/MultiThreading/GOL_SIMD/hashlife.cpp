@@ -0,0 +1,564 @@
+#include "hashlife.h"
+#include "gol.h"
+#include <algorithm>
+#include <limits>
+
+//nodes are allocated this many at a time
+const size_t BlockSize = 4096;
+//largest root, a 2^62 square keeps origins, offsets and shifts inside int64_t
+const int MaxLevel = 62;
+
+HashLife::HashLife(size_t MaxMemory) :
+  blocks(),
+  freeList(nullptr),
+  table(1024, nullptr),
+  emptyNodes(),
+  roots(),
+  dead(new Node()),
+  alive(new Node()),
+  root(nullptr),
+  originY(0),
+  originX(0),
+  step(0),
+  generation(0),
+  nodeCount(0),
+  maxNodes(std::max(MaxMemory / (sizeof(Node) + sizeof(Node*)), BlockSize)),
+  collectThreshold(maxNodes),
+  collections(0)
+{
+  alive->population = 1;
+  emptyNodes.push_back(dead);
+  root = Empty(3);
+}
+
+HashLife::~HashLife()
+{
+  size_t size = blocks.size();
+  for (size_t i = 0; i < size; ++i)
+  {
+    delete[] blocks[i];
+  }
+
+  delete dead;
+  delete alive;
+}
+
+HashLife::Node* HashLife::Allocate()
+{
+  if (!freeList)
+  {
+    Node* block = new Node[BlockSize]();
+    blocks.push_back(block);
+
+    for (size_t i = 0; i < BlockSize; ++i)
+    {
+      block[i].next = freeList;
+      freeList = &block[i];
+    }
+  }
+
+  Node* node = freeList;
+  freeList = node->next;
+  return node;
+}
+
+static size_t HashNode(const void* nw, const void* ne, const void* sw, const void* se)
+{
+  uint64_t h = reinterpret_cast<uintptr_t>(nw);
+  h = h * 0x9E3779B97F4A7C15ull + reinterpret_cast<uintptr_t>(ne);
+  h = h * 0x9E3779B97F4A7C15ull + reinterpret_cast<uintptr_t>(sw);
+  h = h * 0x9E3779B97F4A7C15ull + reinterpret_cast<uintptr_t>(se);
+  return size_t(h ^ (h >> 29));
+}
+
+//canonical node with the given children
+HashLife::Node* HashLife::Find(Node* nw, Node* ne, Node* sw, Node* se)
+{
+  size_t index = HashNode(nw, ne, sw, se) & (table.size() - 1);
+
+  for (Node* node = table[index]; node; node = node->next)
+  {
+    if (node->nw == nw && node->ne == ne && node->sw == sw && node->se == se)
+    {
+      return node;
+    }
+  }
+
+  Node* node = Allocate();
+  node->nw = nw;
+  node->ne = ne;
+  node->sw = sw;
+  node->se = se;
+  node->result = nullptr;
+  node->population = nw->population + ne->population + sw->population + se->population;
+  node->level = nw->level + 1;
+  node->marked = false;
+  node->next = table[index];
+  table[index] = node;
+
+  if (++nodeCount > table.size())
+  {
+    Rehash();
+  }
+
+  return node;
+}
+
+void HashLife::Rehash()
+{
+  std::vector<Node*> bigger(table.size() * 2, nullptr);
+  size_t size = table.size();
+
+  for (size_t i = 0; i < size; ++i)
+  {
+    Node* node = table[i];
+    while (node)
+    {
+      Node* next = node->next;
+      size_t index = HashNode(node->nw, node->ne, node->sw, node->se) & (bigger.size() - 1);
+      node->next = bigger[index];
+      bigger[index] = node;
+      node = next;
+    }
+  }
+
+  table.swap(bigger);
+}
+
+HashLife::Node* HashLife::Empty(int level)
+{
+  while (int(emptyNodes.size()) <= level)
+  {
+    Node* smaller = emptyNodes.back();
+    emptyNodes.push_back(Find(smaller, smaller, smaller, smaller));
+  }
+
+  return emptyNodes[level];
+}
+
+//middle half of a node, one level down, no time step
+HashLife::Node* HashLife::Centre(Node* node)
+{
+  return Find(node->nw->se, node->ne->sw, node->sw->ne, node->se->nw);
+}
+
+//4x4 node, the middle 2x2 advanced one generation
+HashLife::Node* HashLife::StepBase(Node* node)
+{
+  Node* leaves[4][4];
+  Node* quadrants[2][2] = { { node->nw, node->ne }, { node->sw, node->se } };
+
+  for (int r = 0; r < 4; ++r)
+  {
+    for (int c = 0; c < 4; ++c)
+    {
+      Node* quadrant = quadrants[r >> 1][c >> 1];
+      Node* children[2][2] = { { quadrant->nw, quadrant->ne }, { quadrant->sw, quadrant->se } };
+      leaves[r][c] = children[r & 1][c & 1];
+    }
+  }
+
+  Node* next[2][2];
+  for (int r = 1; r <= 2; ++r)
+  {
+    for (int c = 1; c <= 2; ++c)
+    {
+      uint64_t alive_neighbours = 0;
+      for (int R = r - 1; R <= r + 1; ++R)
+      {
+        for (int C = c - 1; C <= c + 1; ++C)
+        {
+          if (R != r || C != c)
+          {
+            alive_neighbours += leaves[R][C]->population;
+          }
+        }
+      }
+
+      bool state = leaves[r][c]->population ? (alive_neighbours == 2 || alive_neighbours == 3) : alive_neighbours == 3;
+      next[r - 1][c - 1] = state ? alive : dead;
+    }
+  }
+
+  return Find(next[0][0], next[0][1], next[1][0], next[1][1]);
+}
+
+//centre of the node advanced min(2^step, 2^(level-2)) generations
+HashLife::Node* HashLife::Successor(Node* node)
+{
+  if (node->result)
+  {
+    return node->result;
+  }
+
+  if (node->population == 0)
+  {
+    node->result = Empty(node->level - 1);
+    return node->result;
+  }
+
+  if (node->level == 2)
+  {
+    node->result = StepBase(node);
+    return node->result;
+  }
+
+  //every node this frame still needs goes on roots, a collection
+  //started further down only keeps what is reachable from there
+  size_t frame = roots.size();
+  roots.push_back(node);
+
+  if (nodeCount >= collectThreshold)
+  {
+    Collect();
+  }
+
+  //9 overlapping subnodes, one level down
+  Node* sub[9] =
+  {
+    node->nw,
+    Find(node->nw->ne, node->ne->nw, node->nw->se, node->ne->sw),
+    node->ne,
+    Find(node->nw->sw, node->nw->se, node->sw->nw, node->sw->ne),
+    Centre(node),
+    Find(node->ne->sw, node->ne->se, node->se->nw, node->se->ne),
+    node->sw,
+    Find(node->sw->ne, node->se->nw, node->sw->se, node->se->sw),
+    node->se
+  };
+  roots.insert(roots.end(), sub, sub + 9);
+
+  //full speed advances twice by 2^(level-3), slower steps only move the
+  //first half in space and leave all of the time step to the second half
+  bool full = step >= node->level - 2;
+  Node* half[9];
+  for (int i = 0; i < 9; ++i)
+  {
+    half[i] = full ? Successor(sub[i]) : Centre(sub[i]);
+    roots.push_back(half[i]);
+  }
+
+  Node* quarter[4] =
+  {
+    Find(half[0], half[1], half[3], half[4]),
+    Find(half[1], half[2], half[4], half[5]),
+    Find(half[3], half[4], half[6], half[7]),
+    Find(half[4], half[5], half[7], half[8])
+  };
+  roots.insert(roots.end(), quarter, quarter + 4);
+
+  Node* result[4];
+  for (int i = 0; i < 4; ++i)
+  {
+    result[i] = Successor(quarter[i]);
+    roots.push_back(result[i]);
+  }
+
+  node->result = Find(result[0], result[1], result[2], result[3]);
+  roots.resize(frame);
+  return node->result;
+}
+
+HashLife::Node* HashLife::SetCell(Node* node, int64_t y, int64_t x, int64_t half)
+{
+  if (node->level == 0)
+  {
+    return alive;
+  }
+
+  Node* nw = node->nw;
+  Node* ne = node->ne;
+  Node* sw = node->sw;
+  Node* se = node->se;
+  int64_t quarter = half >> 1;
+
+  if (y < half)
+  {
+    if (x < half)
+    {
+      nw = SetCell(nw, y, x, quarter);
+    }
+    else
+    {
+      ne = SetCell(ne, y, x - half, quarter);
+    }
+  }
+  else
+  {
+    if (x < half)
+    {
+      sw = SetCell(sw, y - half, x, quarter);
+    }
+    else
+    {
+      se = SetCell(se, y - half, x - half, quarter);
+    }
+  }
+
+  return Find(nw, ne, sw, se);
+}
+
+void HashLife::Load(const std::vector< std::tuple<int, int> >& population)
+{
+  generation = 0;
+  originY = 0;
+  originX = 0;
+
+  size_t size = population.size();
+  if (!size)
+  {
+    root = Empty(3);
+    return;
+  }
+
+  int64_t minY = std::get<0>(population[0]), maxY = minY;
+  int64_t minX = std::get<1>(population[0]), maxX = minX;
+  for (size_t i = 1; i < size; ++i)
+  {
+    minY = std::min<int64_t>(minY, std::get<0>(population[i]));
+    maxY = std::max<int64_t>(maxY, std::get<0>(population[i]));
+    minX = std::min<int64_t>(minX, std::get<1>(population[i]));
+    maxX = std::max<int64_t>(maxX, std::get<1>(population[i]));
+  }
+
+  int level = 3;
+  while ((int64_t(1) << level) <= std::max(maxY - minY, maxX - minX))
+  {
+    ++level;
+  }
+
+  originY = minY;
+  originX = minX;
+  root = Empty(level);
+
+  for (size_t i = 0; i < size; ++i)
+  {
+    root = SetCell(root, std::get<0>(population[i]) - minY, std::get<1>(population[i]) - minX, int64_t(1) << (level - 1));
+  }
+}
+
+//all live cells are inside the middle half
+bool HashLife::IsCentred(Node* node) const
+{
+  return node->nw->population == node->nw->se->population &&
+    node->ne->population == node->ne->sw->population &&
+    node->sw->population == node->sw->ne->population &&
+    node->se->population == node->se->nw->population;
+}
+
+//grow the root one level, keeping the pattern in the middle
+void HashLife::Expand()
+{
+  Node* border = Empty(root->level - 1);
+  Node* nw = Find(border, border, border, root->nw);
+  Node* ne = Find(border, border, root->ne, border);
+  Node* sw = Find(border, root->sw, border, border);
+  Node* se = Find(root->se, border, border, border);
+
+  int64_t shift = int64_t(1) << (root->level - 1);
+  originY -= shift;
+  originX -= shift;
+  root = Find(nw, ne, sw, se);
+}
+
+bool HashLife::AdvancePow2(int exponent)
+{
+  if (root->population == 0)
+  {
+    generation += 1ull << exponent;
+    return true;
+  }
+
+  //the step needs a root of level exponent + 3, bigger steps are split
+  if (exponent > MaxLevel - 3)
+  {
+    return AdvancePow2(exponent - 1) && AdvancePow2(exponent - 1);
+  }
+
+  //cached results are only valid for the step they were computed with
+  if (exponent != step)
+  {
+    ClearResults();
+    step = exponent;
+  }
+
+  //the pattern must sit in the middle quarter of a big enough root, so that
+  //2^exponent generations can not carry it out of the middle half
+  while (root->level < exponent + 2 || !IsCentred(root))
+  {
+    if (root->level >= MaxLevel - 1)
+    {
+      //the pattern is about to leave the plane
+      return false;
+    }
+    Expand();
+  }
+  Expand();
+
+  int64_t shift = int64_t(1) << (root->level - 2);
+  root = Successor(root);
+  originY += shift;
+  originX += shift;
+  generation += 1ull << exponent;
+
+  //drop empty borders so the root does not keep growing
+  while (root->level > 3 && IsCentred(root))
+  {
+    shift = int64_t(1) << (root->level - 2);
+    root = Centre(root);
+    originY += shift;
+    originX += shift;
+  }
+  return true;
+}
+
+bool HashLife::Advance(unsigned long long generations)
+{
+  for (int exponent = 0; exponent < 64 && (generations >> exponent); ++exponent)
+  {
+    if (((generations >> exponent) & 1) && !AdvancePow2(exponent))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+void HashLife::ClearResults()
+{
+  size_t size = table.size();
+  for (size_t i = 0; i < size; ++i)
+  {
+    for (Node* node = table[i]; node; node = node->next)
+    {
+      node->result = nullptr;
+    }
+  }
+}
+
+void HashLife::Mark(Node* node)
+{
+  if (node->level == 0 || node->marked)
+  {
+    return;
+  }
+
+  node->marked = true;
+  Mark(node->nw);
+  Mark(node->ne);
+  Mark(node->sw);
+  Mark(node->se);
+}
+
+//mark and sweep, everything reachable from the pattern, the empty nodes and
+//the nodes held by Successor frames survives, cached results are not roots
+void HashLife::Collect()
+{
+  Mark(root);
+
+  size_t size = roots.size();
+  for (size_t i = 0; i < size; ++i)
+  {
+    Mark(roots[i]);
+  }
+
+  size = emptyNodes.size();
+  for (size_t i = 0; i < size; ++i)
+  {
+    Mark(emptyNodes[i]);
+  }
+
+  //forget results that are about to be freed
+  size = table.size();
+  for (size_t i = 0; i < size; ++i)
+  {
+    for (Node* node = table[i]; node; node = node->next)
+    {
+      if (node->marked && node->result && node->result->level && !node->result->marked)
+      {
+        node->result = nullptr;
+      }
+    }
+  }
+
+  for (size_t i = 0; i < size; ++i)
+  {
+    Node** link = &table[i];
+    while (*link)
+    {
+      Node* node = *link;
+      if (node->marked)
+      {
+        node->marked = false;
+        link = &node->next;
+      }
+      else
+      {
+        *link = node->next;
+        node->next = freeList;
+        freeList = node;
+        --nodeCount;
+      }
+    }
+  }
+
+  //when the live pattern alone fills most of the cap collecting again right
+  //away would free nothing, let the cache grow past it instead, so maxNodes
+  //is advisory (see the constructor in hashlife.h)
+  collectThreshold = std::max(maxNodes, nodeCount * 2);
+  ++collections;
+}
+
+void HashLife::CollectLive(Node* node, int64_t y, int64_t x, std::vector< std::tuple<int, int> >& live) const
+{
+  if (node->population == 0)
+  {
+    return;
+  }
+
+  //Live reports int coordinates, skip squares entirely outside that range
+  int64_t size = int64_t(1) << node->level;
+  if (y > std::numeric_limits<int>::max() || x > std::numeric_limits<int>::max() ||
+    y + size <= std::numeric_limits<int>::min() || x + size <= std::numeric_limits<int>::min())
+  {
+    return;
+  }
+
+  if (node->level == 0)
+  {
+    live.push_back(std::make_tuple(int(y), int(x)));
+    return;
+  }
+
+  int64_t half = int64_t(1) << (node->level - 1);
+  CollectLive(node->nw, y, x, live);
+  CollectLive(node->ne, y, x + half, live);
+  CollectLive(node->sw, y + half, x, live);
+  CollectLive(node->se, y + half, x + half, live);
+}
+
+std::vector< std::tuple<int, int> > HashLife::Live() const
+{
+  std::vector< std::tuple<int, int> > live;
+  CollectLive(root, originY, originX, live);
+  std::sort(live.begin(), live.end());
+  return live;
+}
+
+unsigned long long HashLife::GetPopulation() const
+{
+  return root->population;
+}
+
+size_t HashLife::GetMemoryUsed() const
+{
+  return blocks.size() * BlockSize * sizeof(Node) + table.size() * sizeof(Node*);
+}
+
+std::vector< std::tuple<int, int> > run_hashlife(std::vector< std::tuple<int, int> > initial_population, unsigned long long num_iter, size_t max_memory)
+{
+  HashLife life(max_memory);
+  life.Load(initial_population);
+  life.Advance(num_iter);
+  return life.Live();
+}
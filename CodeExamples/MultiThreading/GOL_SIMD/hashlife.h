@@ -0,0 +1,93 @@
+#ifndef HASHLIFE_H
+#define HASHLIFE_H
+#include <vector>
+#include <tuple>
+#include <cstdint>
+#include <cstddef>
+
+//memoised quadtree Game of Life (HashLife) on an unbounded plane
+//identical subtrees are shared through a hash table and every node caches
+//its centre advanced by the current step, so repeating patterns are computed once
+class HashLife
+{
+public:
+  //maxMemory caps the node cache, when it fills up the nodes that are not
+  //reachable from the current pattern are collected; the cap is advisory, once
+  //the reachable nodes alone take more than half of it the cache may grow to
+  //twice their count so it does not collect on every step
+  HashLife(size_t MaxMemory = size_t(256) << 20);
+  ~HashLife();
+
+  //replace the pattern, coordinates are (row, column) as in run()
+  void Load(const std::vector< std::tuple<int, int> >& population);
+
+  //advance 2^exponent generations; false, with the generation left at the
+  //last completed step, once the pattern would grow out of a 2^62 square
+  bool AdvancePow2(int exponent);
+  //advance any number of generations, one power of two step per set bit
+  bool Advance(unsigned long long generations);
+
+  //live cells in row major order, cells outside the int range are left out
+  std::vector< std::tuple<int, int> > Live() const;
+
+  unsigned long long GetPopulation() const;
+  unsigned long long GetGeneration() const { return generation; }
+  //nodes currently in the cache
+  size_t GetNodeCount() const { return nodeCount; }
+  //bytes held by node blocks and the hash table
+  size_t GetMemoryUsed() const;
+  //number of garbage collections so far
+  size_t GetCollectionCount() const { return collections; }
+
+private:
+  struct Node
+  {
+    Node* nw;
+    Node* ne;
+    Node* sw;
+    Node* se;
+    Node* result;     //centre advanced min(2^step, 2^(level-2)) generations
+    Node* next;       //hash chain
+    uint64_t population;
+    int level;
+    bool marked;
+  };
+
+  //no copies, nodes are owned by the allocator blocks
+  HashLife(const HashLife&);
+  HashLife& operator=(const HashLife&);
+
+  Node* Allocate();
+  Node* Find(Node* nw, Node* ne, Node* sw, Node* se);
+  Node* Empty(int level);
+  Node* Centre(Node* node);
+  Node* Successor(Node* node);
+  Node* StepBase(Node* node);
+  Node* SetCell(Node* node, int64_t y, int64_t x, int64_t half);
+  bool IsCentred(Node* node) const;
+  void Expand();
+  void Rehash();
+  void ClearResults();
+  void Collect();
+  void Mark(Node* node);
+  void CollectLive(Node* node, int64_t y, int64_t x, std::vector< std::tuple<int, int> >& live) const;
+
+  std::vector<Node*> blocks;      //node storage, never handed back until destruction
+  Node* freeList;
+  std::vector<Node*> table;       //hash buckets
+  std::vector<Node*> emptyNodes;  //empty node of every level
+  std::vector<Node*> roots;       //nodes held by Successor frames, kept alive by collections
+  Node* dead;
+  Node* alive;
+  Node* root;
+  int64_t originY;                //top left cell of root
+  int64_t originX;
+  int step;                       //exponent the cached results were computed for
+  unsigned long long generation;
+  size_t nodeCount;
+  size_t maxNodes;
+  size_t collectThreshold;
+  size_t collections;
+};
+
+#endif
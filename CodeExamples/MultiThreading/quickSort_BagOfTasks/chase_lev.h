@@ -0,0 +1,91 @@
+#ifndef CHASE_LEV_H
+#define CHASE_LEV_H
+#include <atomic>
+#include <type_traits>
+
+//Chase-Lev work stealing deque with a fixed capacity
+//
+//The owner pushes and pops at the bottom (newest first), any other thread
+//steals from the top (oldest first). Memory orders follow Le, Pop, Cohen and
+//Zappa Nardelli, "Correct and Efficient Work-Stealing for Weak Memory Models".
+//Items are kept in atomics, so T has to be small and trivially copyable.
+template <typename T, unsigned Capacity = 128>
+class ChaseLevDeque
+{
+  static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+  static_assert(std::is_trivially_copyable<T>::value, "T must be trivially copyable");
+
+public:
+  ChaseLevDeque() : top(0), bottom(0) {}
+
+  //owner only, false when the deque is full
+  bool Push(T const& item)
+  {
+    long b = bottom.load(std::memory_order_relaxed);
+    long t = top.load(std::memory_order_acquire);
+    if (b - t >= long(Capacity))
+    {
+      return false;
+    }
+
+    buffer[b & (Capacity - 1)].store(item, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom.store(b + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  //owner only, newest item
+  bool Pop(T& item)
+  {
+    long b = bottom.load(std::memory_order_relaxed) - 1;
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    long t = top.load(std::memory_order_relaxed);
+
+    if (t > b)
+    {
+      //empty
+      bottom.store(b + 1, std::memory_order_relaxed);
+      return false;
+    }
+
+    item = buffer[b & (Capacity - 1)].load(std::memory_order_relaxed);
+    if (t == b)
+    {
+      //last item, race the thieves for it
+      bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+      bottom.store(b + 1, std::memory_order_relaxed);
+      return won;
+    }
+    return true;
+  }
+
+  //any thread, oldest item, false when empty or another thread got it first
+  bool Steal(T& item)
+  {
+    long t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    long b = bottom.load(std::memory_order_acquire);
+
+    if (t >= b)
+    {
+      return false;
+    }
+
+    item = buffer[t & (Capacity - 1)].load(std::memory_order_relaxed);
+    return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+  }
+
+  //racy hint for idle threads
+  bool Empty() const
+  {
+    return top.load(std::memory_order_relaxed) >= bottom.load(std::memory_order_relaxed);
+  }
+
+private:
+  alignas(64) std::atomic<long> top;
+  alignas(64) std::atomic<long> bottom;
+  std::atomic<T> buffer[Capacity];
+};
+
+#endif
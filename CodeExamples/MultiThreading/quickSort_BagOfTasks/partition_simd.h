@@ -0,0 +1,214 @@
+#ifndef PARTITION_SIMD_H
+#define PARTITION_SIMD_H
+#include <cstddef>
+#include <cstdint>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+//Branch free partition kernels for int, float and double
+//
+//simd_partition<T>::enabled says whether T has a vector kernel for the target
+//the code is compiled for (-mavx2 or -march=native), quicksort uses its scalar
+//loop for everything else.
+//Partition(a, n, pivot) moves the keys less than pivot to the front of a and
+//returns how many there are, neither side keeps its order.
+//
+//The first and the last vector are held in registers, which leaves one free
+//vector at each end. The kernel then reads a vector from the end with less
+//free room, permutes it through a table indexed by the comparison mask so the
+//keys less than the pivot come first, and stores it to both ends at once;
+//only the matching part of each store is kept. A read always adds a vector of
+//room, so both ends keep room for a full store and no key is branched on.
+template <typename T>
+struct simd_partition
+{
+  enum { enabled = 0 };
+};
+
+#ifdef __AVX2__
+
+//permutation for every comparison mask, lanes whose bit is set come first,
+//as 32-bit lane indices for permutevar8x32 (a 64-bit lane is two of them)
+template <int Lanes>
+struct partition_table
+{
+  enum { Scale = 8 / Lanes };
+
+  partition_table()
+  {
+    for (int mask = 0; mask < (1 << Lanes); ++mask)
+    {
+      int out = 0;
+      for (int pass = 0; pass < 2; ++pass)
+      {
+        for (int lane = 0; lane < Lanes; ++lane)
+        {
+          if (((mask >> lane) & 1) == (pass == 0 ? 1 : 0))
+          {
+            for (int s = 0; s < Scale; ++s)
+            {
+              index[mask][out++] = lane * Scale + s;
+            }
+          }
+        }
+      }
+    }
+  }
+
+  static const partition_table& Get()
+  {
+    static const partition_table table;
+    return table;
+  }
+
+  alignas(32) int32_t index[1 << Lanes][8];
+};
+
+struct partition_ops_int
+{
+  typedef int T;
+  typedef __m256i V;
+  enum { Lanes = 8 };
+
+  static V Load(const T* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+  static void Store(T* p, V v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+  static V Set1(T x) { return _mm256_set1_epi32(x); }
+  static int Less(V v, V pivot) { return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(pivot, v))); }
+  static V Permute(V v, const int32_t* index)
+  {
+    return _mm256_permutevar8x32_epi32(v, _mm256_load_si256(reinterpret_cast<const __m256i*>(index)));
+  }
+};
+
+struct partition_ops_float
+{
+  typedef float T;
+  typedef __m256 V;
+  enum { Lanes = 8 };
+
+  static V Load(const T* p) { return _mm256_loadu_ps(p); }
+  static void Store(T* p, V v) { _mm256_storeu_ps(p, v); }
+  static V Set1(T x) { return _mm256_set1_ps(x); }
+  //ordered compare, a NaN goes right just like with the scalar a[j] < pivot
+  static int Less(V v, V pivot) { return _mm256_movemask_ps(_mm256_cmp_ps(v, pivot, _CMP_LT_OQ)); }
+  static V Permute(V v, const int32_t* index)
+  {
+    return _mm256_permutevar8x32_ps(v, _mm256_load_si256(reinterpret_cast<const __m256i*>(index)));
+  }
+};
+
+struct partition_ops_double
+{
+  typedef double T;
+  typedef __m256d V;
+  enum { Lanes = 4 };
+
+  static V Load(const T* p) { return _mm256_loadu_pd(p); }
+  static void Store(T* p, V v) { _mm256_storeu_pd(p, v); }
+  static V Set1(T x) { return _mm256_set1_pd(x); }
+  static int Less(V v, V pivot) { return _mm256_movemask_pd(_mm256_cmp_pd(v, pivot, _CMP_LT_OQ)); }
+  static V Permute(V v, const int32_t* index)
+  {
+    __m256i i = _mm256_load_si256(reinterpret_cast<const __m256i*>(index));
+    return _mm256_castps_pd(_mm256_permutevar8x32_ps(_mm256_castpd_ps(v), i));
+  }
+};
+
+//n has to be at least 2 * Lanes
+template <typename Ops>
+size_t simd_partition_kernel(typename Ops::T* a, size_t n, typename Ops::T pivot)
+{
+  typedef typename Ops::T T;
+  typedef typename Ops::V V;
+  const size_t L = Ops::Lanes;
+  const partition_table<Ops::Lanes>& table = partition_table<Ops::Lanes>::Get();
+  const V p = Ops::Set1(pivot);
+
+  V head = Ops::Load(a);
+  V tail = Ops::Load(a + n - L);
+  size_t l = L, r = n - L;      //not read yet [l, r)
+  size_t wl = 0, wr = n;        //done [0, wl) and [wr, n)
+
+  while (r - l >= L)
+  {
+    V v;
+    if (l - wl <= wr - r)
+    {
+      v = Ops::Load(a + l);
+      l += L;
+    }
+    else
+    {
+      r -= L;
+      v = Ops::Load(a + r);
+    }
+
+    int mask = Ops::Less(v, p);
+    V sorted = Ops::Permute(v, table.index[mask]);
+    size_t less = size_t(__builtin_popcount(unsigned(mask)));
+    Ops::Store(a + wl, sorted);
+    Ops::Store(a + wr - L, sorted);
+    wl += less;
+    wr -= L - less;
+  }
+
+  //fewer than L keys are left unread, once they are copied out [wl, wr) is
+  //free and holds at least two vectors, room for the head without overlap
+  T rest[2 * L];
+  size_t count = r - l;
+  for (size_t i = 0; i < count; ++i)
+  {
+    rest[i] = a[l + i];
+  }
+
+  int mask = Ops::Less(head, p);
+  V sorted = Ops::Permute(head, table.index[mask]);
+  size_t less = size_t(__builtin_popcount(unsigned(mask)));
+  Ops::Store(a + wl, sorted);
+  Ops::Store(a + wr - L, sorted);
+  wl += less;
+  wr -= L - less;
+
+  //the tail and the rest are placed one key at a time, two stores could overlap now
+  Ops::Store(rest + count, tail);
+  count += L;
+  for (size_t i = 0; i < count; ++i)
+  {
+    if (rest[i] < pivot)
+    {
+      a[wl++] = rest[i];
+    }
+    else
+    {
+      a[--wr] = rest[i];
+    }
+  }
+
+  return wl;
+}
+
+template <>
+struct simd_partition<int>
+{
+  enum { enabled = 1, MinSize = 64 };
+  static size_t Partition(int* a, size_t n, int pivot) { return simd_partition_kernel<partition_ops_int>(a, n, pivot); }
+};
+
+template <>
+struct simd_partition<float>
+{
+  enum { enabled = 1, MinSize = 64 };
+  static size_t Partition(float* a, size_t n, float pivot) { return simd_partition_kernel<partition_ops_float>(a, n, pivot); }
+};
+
+template <>
+struct simd_partition<double>
+{
+  enum { enabled = 1, MinSize = 32 };
+  static size_t Partition(double* a, size_t n, double pivot) { return simd_partition_kernel<partition_ops_double>(a, n, pivot); }
+};
+
+#endif
+
+#endif
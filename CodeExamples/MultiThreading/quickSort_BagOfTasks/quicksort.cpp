@@ -5,6 +5,8 @@
 #include <mutex>
 #include <atomic>
 #include <condition_variable>
+#include <type_traits>
+#include "partition_simd.h"
 
 class Semaphore {
 public:
@@ -38,17 +40,58 @@ int arrSize = 0;
 std::atomic<int> counter(0);
 Semaphore sm(1);
 
-template< typename T>
-unsigned partition(T* a, unsigned begin, unsigned end) {
-  unsigned i = begin, last = end - 1;
-  T pivot = a[last];
+//time the bag of tasks threads spent waiting on sm and containerLock,
+//only measured when QUICKSORT_LOCK_STATS is defined (see quicksort_bench.cpp)
+std::atomic<long long> lockWaitNanos(0);
 
-  for (unsigned j = begin; j < last; ++j) {
+#ifdef QUICKSORT_LOCK_STATS
+#include <chrono>
+struct lock_wait_timer {
+  lock_wait_timer() : start(std::chrono::steady_clock::now()) {}
+  void Stop() {
+    lockWaitNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+  }
+  std::chrono::steady_clock::time_point start;
+};
+#else
+struct lock_wait_timer {
+  void Stop() {}
+};
+#endif
+
+//partition [begin, end) around a given pivot, returns the first index not less than it
+template< typename T>
+unsigned partition_block(T* a, unsigned begin, unsigned end, T const& pivot, std::false_type) {
+  unsigned i = begin;
+  for (unsigned j = begin; j < end; ++j) {
     if (a[j] < pivot) {
       std::swap(a[j], a[i]);
       ++i;
     }
   }
+  return i;
+}
+
+//int, float and double use the vector kernel when it was compiled in
+template< typename T>
+unsigned partition_block(T* a, unsigned begin, unsigned end, T const& pivot, std::true_type) {
+  if (end - begin < unsigned(simd_partition<T>::MinSize)) {
+    return partition_block(a, begin, end, pivot, std::false_type());
+  }
+  return begin + unsigned(simd_partition<T>::Partition(a + begin, end - begin, pivot));
+}
+
+template< typename T>
+unsigned partition_block(T* a, unsigned begin, unsigned end, T const& pivot) {
+  return partition_block(a, begin, end, pivot, std::integral_constant<bool, simd_partition<T>::enabled != 0>());
+}
+
+template< typename T>
+unsigned partition(T* a, unsigned begin, unsigned end) {
+  unsigned last = end - 1;
+  T pivot = a[last];
+
+  unsigned i = partition_block(a, begin, last, pivot);
   std::swap(a[i], a[last]);
   return i;
 }
@@ -75,24 +118,413 @@ unsigned partition_new(T* a, unsigned begin, unsigned end) {
   return i;
 }
 
+/* three way */
+
+//ranges shorter than this skip the pivot sample and use partition as it is
+const unsigned sample_min = 128;
+
+//moves the median of nine evenly spaced keys to a[end - 1], where partition
+//takes its pivot from; true when another sampled key equals the median,
+//which is the hint that the range holds many duplicates
+template< typename T>
+bool pivot_sample(T* a, unsigned begin, unsigned end) {
+  unsigned index[9];
+  unsigned step = (end - begin) / 9;
+  for (int i = 0; i < 9; ++i) {
+    index[i] = begin + i * step + step / 2;
+  }
+
+  //insertion sort of the positions by key
+  for (int i = 1; i < 9; ++i) {
+    unsigned current = index[i];
+    int j = i;
+    for (; j > 0 && a[current] < a[index[j - 1]]; --j) {
+      index[j] = index[j - 1];
+    }
+    index[j] = current;
+  }
+
+  T const& median = a[index[4]];
+  bool duplicates = !(a[index[3]] < median) || !(median < a[index[5]]);
+  std::swap(a[index[4]], a[end - 1]);
+  return duplicates;
+}
+
+//Dutch national flag around the pivot at a[end - 1]: keys less than it end in
+//[begin, lo), keys equal to it in [lo, hi), greater keys in [hi, end)
+template< typename T>
+void partition3(T* a, unsigned begin, unsigned end, unsigned& lo, unsigned& hi) {
+  T const pivot = a[end - 1];
+  unsigned i = begin;
+  lo = begin;
+  hi = end;
+
+  while (i < hi) {
+    if (a[i] < pivot) {
+      std::swap(a[lo++], a[i++]);
+    }
+    else if (pivot < a[i]) {
+      std::swap(a[i], a[--hi]);
+    }
+    else {
+      ++i;
+    }
+  }
+}
+
+//splits [begin, end) for the recursion, [lo, hi) is in place afterwards:
+//one pivot after a two way partition, every key equal to the pivot after a
+//three way one, which is chosen when the pivot sample shows duplicates
+template< typename T>
+void partition_adaptive(T* a, unsigned begin, unsigned end, unsigned& lo, unsigned& hi) {
+  if (end - begin >= sample_min && pivot_sample(a, begin, end)) {
+    partition3(a, begin, end, lo, hi);
+    return;
+  }
+
+  lo = partition(a, begin, end);
+  hi = lo + 1;
+}
+
 /* recursive */
+
+//ranges up to this size are finished by one sorting network
+#ifndef SMALL_SORT_CUTOFF
+#define SMALL_SORT_CUTOFF 12
+#endif
+const unsigned small_sort_cutoff = SMALL_SORT_CUTOFF < small_sort_max ? SMALL_SORT_CUTOFF : small_sort_max;
+
 template< typename T>
 void quicksort_rec(T* a, unsigned begin, unsigned end)
 {
-  if (end - begin < 6) {
-    switch (end - begin) {
-    case 5: quicksort_base_5(a + begin); break;
-    case 4: quicksort_base_4(a + begin); break;
-    case 3: quicksort_base_3(a + begin); break;
-    case 2: quicksort_base_2(a + begin); break;
+  if (end - begin <= small_sort_cutoff) {
+    small_sort(a + begin, end - begin);
+    return;
+  }
+
+  unsigned lo, hi;
+  partition_adaptive(a, begin, end, lo, hi);
+
+  //[lo, hi) is in place, leaving it out also ends the recursion when every key is equal
+  quicksort_rec(a, begin, lo);
+  quicksort_rec(a, hi, end);
+}
+
+/* parallel partition */
+#include <vector>
+#include <algorithm>
+
+//ranges at least this long are partitioned by all threads together
+const unsigned parallel_partition_min = 1u << 18;
+
+//run f(0) .. f(numThreads - 1) on numThreads threads, the caller runs f(0)
+template< typename F>
+void run_threads(int numThreads, F const& f)
+{
+  std::vector<std::thread> threads;
+  for (int i = 1; i < numThreads; ++i) {
+    threads.push_back(std::thread(f, i));
+  }
+  f(0);
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+}
+
+//position of the k-th index covered by a list of intervals
+inline unsigned interval_index(std::vector< std::pair<unsigned, unsigned> > const& intervals, unsigned k, size_t& interval) {
+  interval = 0;
+  while (k >= intervals[interval].second - intervals[interval].first) {
+    k -= intervals[interval].second - intervals[interval].first;
+    ++interval;
+  }
+  return intervals[interval].first + k;
+}
+
+//splits [begin, end) with numThreads threads: every thread runs block on one
+//slice, block(b, e) partitions [b, e) and returns the first index of its
+//upper part, which leaves the lower keys in numThreads runs, then the keys
+//that are on the wrong side of the final split are swapped across it, again
+//split evenly over the threads; returns the first index of the upper part
+template< typename T, typename Block>
+unsigned partition_parallel_blocks(T* a, unsigned begin, unsigned end, int numThreads, Block const& block) {
+  if (numThreads < 2 || end - begin < parallel_partition_min) {
+    return block(begin, end);
+  }
+
+  std::vector<unsigned> first(numThreads + 1), split(numThreads);
+  for (int i = 0; i <= numThreads; ++i) {
+    first[i] = begin + unsigned((unsigned long long)(end - begin) * i / numThreads);
+  }
+
+  run_threads(numThreads, [&](int i) {
+    split[i] = block(first[i], first[i + 1]);
+  });
+
+  unsigned q = begin;
+  for (int i = 0; i < numThreads; ++i) {
+    q += split[i] - first[i];
+  }
+
+  //upper keys left of q and lower keys right of q, there are as many of one
+  //as of the other
+  std::vector< std::pair<unsigned, unsigned> > high, low;
+  unsigned misplaced = 0;
+  for (int i = 0; i < numThreads; ++i) {
+    if (split[i] < std::min(first[i + 1], q)) {
+      high.push_back(std::make_pair(split[i], std::min(first[i + 1], q)));
+      misplaced += high.back().second - high.back().first;
+    }
+    if (std::max(first[i], q) < split[i]) {
+      low.push_back(std::make_pair(std::max(first[i], q), split[i]));
+    }
+  }
+
+  if (misplaced) {
+    run_threads(numThreads, [&](int t) {
+      unsigned k = unsigned((unsigned long long)misplaced * t / numThreads);
+      unsigned stop = unsigned((unsigned long long)misplaced * (t + 1) / numThreads);
+      if (k == stop) {
+        return;
+      }
+
+      size_t h, l;
+      unsigned i = interval_index(high, k, h);
+      unsigned j = interval_index(low, k, l);
+      for (; k < stop; ++k) {
+        std::swap(a[i++], a[j++]);
+        if (i == high[h].second && h + 1 < high.size()) i = high[++h].first;
+        if (j == low[l].second && l + 1 < low.size()) j = low[++l].first;
+      }
+    });
+  }
+
+  return q;
+}
+
+//same contract as partition, done by numThreads threads; the pivot is the
+//median of three unless pivotPlaced says a[end - 1] already holds a chosen one
+template< typename T>
+unsigned partition_parallel(T* a, unsigned begin, unsigned end, int numThreads, bool pivotPlaced = false) {
+  if (numThreads < 2 || end - begin < parallel_partition_min) {
+    return partition(a, begin, end);
+  }
+
+  //median of three, parked at the end where partition keeps its pivot
+  unsigned last = end - 1;
+  if (!pivotPlaced) {
+    unsigned middle = begin + (end - begin) / 2;
+    if (a[middle] < a[begin]) std::swap(a[middle], a[begin]);
+    if (a[last] < a[begin]) std::swap(a[last], a[begin]);
+    if (a[middle] < a[last]) std::swap(a[middle], a[last]);
+  }
+  T const pivot = a[last];
+
+  unsigned q = partition_parallel_blocks(a, begin, last, numThreads, [&](unsigned b, unsigned e) {
+    return partition_block(a, b, e, pivot);
+  });
+
+  std::swap(a[q], a[last]);
+  return q;
+}
+
+//same contract as partition3, done by numThreads threads: a parallel two way
+//partition around a[end - 1], then the keys equal to the pivot are split off
+//the upper part by a second parallel pass
+template< typename T>
+void partition3_parallel(T* a, unsigned begin, unsigned end, int numThreads, unsigned& lo, unsigned& hi) {
+  lo = partition_parallel(a, begin, end, numThreads, true);
+  T const pivot = a[lo];
+
+  hi = partition_parallel_blocks(a, lo + 1, end, numThreads, [&](unsigned b, unsigned e) {
+    return unsigned(std::partition(a + b, a + e, [&](T const& key) { return !(pivot < key); }) - a);
+  });
+}
+
+//partitions the top levels with all threads, each half continues with a share
+//of the threads that matches its size; ranges left with one thread, or too
+//short to split in parallel, are added to ranges
+template< typename T>
+void quicksort_top_levels(T* a, unsigned begin, unsigned end, int numThreads,
+  std::vector< std::pair<unsigned, unsigned> >& ranges, std::mutex& rangesLock)
+{
+  if (numThreads < 2 || end - begin < parallel_partition_min) {
+    if (end - begin) {
+      std::lock_guard<std::mutex> lock(rangesLock);
+      ranges.push_back(std::make_pair(begin, end));
     }
     return;
   }
 
-  unsigned q = partition(a, begin, end);
+  //the threads split the range together around the sampled median, with
+  //many duplicates every key equal to it is taken out as well
+  unsigned lo, hi;
+  if (pivot_sample(a, begin, end)) {
+    partition3_parallel(a, begin, end, numThreads, lo, hi);
+  }
+  else {
+    lo = partition_parallel(a, begin, end, numThreads, true);
+    hi = lo + 1;
+  }
 
-  quicksort_rec(a, begin, q);
-  quicksort_rec(a, q, end);
+  unsigned long long rest = (lo - begin) + (end - hi);
+  int leftThreads = rest ? int(double(numThreads) * (lo - begin) / rest + 0.5) : 1;
+  leftThreads = std::max(1, std::min(numThreads - 1, leftThreads));
+
+  std::thread left([&]() {
+    quicksort_top_levels(a, begin, lo, leftThreads, ranges, rangesLock);
+  });
+  quicksort_top_levels(a, hi, end, numThreads - leftThreads, ranges, rangesLock);
+  left.join();
+}
+
+/* radix sort */
+#include <cstring>
+#include <cstdint>
+#include <memory>
+
+//arrays of arithmetic keys at least this long are radix sorted by quicksort
+const unsigned radix_min = 1u << 16;
+
+//maps a key to an unsigned integer with the same order, enabled tells
+//whether quicksort can radix sort T at all
+template< typename T, typename Enable = void>
+struct radix_traits {
+  enum { enabled = 0 };
+};
+
+//signed integers: flipping the sign bit moves the negatives below the rest
+template< typename T>
+struct radix_traits< T, typename std::enable_if< std::is_integral<T>::value && !std::is_same<T, bool>::value >::type > {
+  enum { enabled = 1 };
+  typedef typename std::make_unsigned<T>::type U;
+  static U Key(T x) {
+    U u = U(x);
+    if (std::is_signed<T>::value) {
+      u ^= U(U(1) << (sizeof(U) * 8 - 1));
+    }
+    return u;
+  }
+};
+
+//IEEE floats: negatives have all bits flipped, positives only the sign bit
+template< typename T, typename Bits>
+struct radix_traits_float {
+  enum { enabled = 1 };
+  typedef Bits U;
+  static U Key(T x) {
+    U u;
+    std::memcpy(&u, &x, sizeof(u));
+    U sign = U(1) << (sizeof(U) * 8 - 1);
+    return (u & sign) ? U(~u) : U(u | sign);
+  }
+};
+
+template<>
+struct radix_traits<float> : radix_traits_float<float, uint32_t> {};
+
+template<>
+struct radix_traits<double> : radix_traits_float<double, uint64_t> {};
+
+//LSD radix sort over 8-bit digits, stable. Every pass each thread counts the
+//digits of its own slice, the counts are turned into one write position per
+//thread and digit, then every thread scatters its slice in order. Keys are
+//staged per digit in a cache line sized buffer and written out a line at a
+//time, so the scatter touches 256 output streams without thrashing the cache.
+//Passes where all keys have the same digit are skipped.
+template< typename T>
+void radix_sort(T* a, unsigned n, int numThreads) {
+  typedef radix_traits<T> traits;
+  typedef typename traits::U U;
+  const int digits = int(sizeof(U));
+  const unsigned line = 64 / sizeof(T);
+
+  if (numThreads < 1) {
+    numThreads = 1;
+  }
+
+  std::unique_ptr<T[]> buffer(new T[n]);
+  T* from = a;
+  T* to = buffer.get();
+
+  std::vector<unsigned> first(numThreads + 1);
+  for (int t = 0; t <= numThreads; ++t) {
+    first[t] = unsigned((unsigned long long)n * t / numThreads);
+  }
+  std::vector<unsigned> count(size_t(numThreads) * 256);
+
+  for (int digit = 0; digit < digits; ++digit) {
+    const int shift = digit * 8;
+
+    run_threads(numThreads, [&](int t) {
+      unsigned* c = &count[size_t(t) * 256];
+      std::fill(c, c + 256, 0u);
+      for (unsigned i = first[t]; i < first[t + 1]; ++i) {
+        ++c[(traits::Key(from[i]) >> shift) & 0xff];
+      }
+    });
+
+    //prefix sum, digit major and thread minor so equal digits keep their order
+    unsigned sum = 0;
+    bool trivial = false;
+    for (int d = 0; d < 256; ++d) {
+      unsigned total = 0;
+      for (int t = 0; t < numThreads; ++t) {
+        unsigned& c = count[size_t(t) * 256 + d];
+        total += c;
+        unsigned next = sum + c;
+        c = sum;
+        sum = next;
+      }
+      trivial = trivial || total == n;
+    }
+    if (trivial) {
+      continue;
+    }
+
+    run_threads(numThreads, [&](int t) {
+      unsigned* position = &count[size_t(t) * 256];
+      alignas(64) T staged[256 * (64 / sizeof(T))];
+      unsigned fill[256] = { 0 };
+
+      for (unsigned i = first[t]; i < first[t + 1]; ++i) {
+        unsigned d = unsigned((traits::Key(from[i]) >> shift) & 0xff);
+        staged[d * line + fill[d]] = from[i];
+        if (++fill[d] == line) {
+          std::memcpy(to + position[d], &staged[d * line], line * sizeof(T));
+          position[d] += line;
+          fill[d] = 0;
+        }
+      }
+
+      for (unsigned d = 0; d < 256; ++d) {
+        std::memcpy(to + position[d], &staged[d * line], fill[d] * sizeof(T));
+      }
+    });
+
+    std::swap(from, to);
+  }
+
+  if (from != a) {
+    run_threads(numThreads, [&](int t) {
+      std::memcpy(a + first[t], from + first[t], (first[t + 1] - first[t]) * sizeof(T));
+    });
+  }
+}
+
+//quicksort hands arithmetic arrays to radix_sort, false when it did not
+template< typename T>
+bool quicksort_radix(T*, unsigned, unsigned, int, std::false_type) {
+  return false;
+}
+
+template< typename T>
+bool quicksort_radix(T* a, unsigned begin, unsigned end, int numThreads, std::true_type) {
+  if (end - begin < radix_min) {
+    return false;
+  }
+  radix_sort(a + begin, end - begin, numThreads);
+  return true;
 }
 
 /* iterative */
@@ -145,6 +577,10 @@ void quicksort_iterative_aux(Container<T>& ranges);
 template< typename T>
 void quicksort_iterative(T* a, unsigned begin, unsigned end)
 {
+  //the loop runs until the shared counter covers the range
+  arrSize = end - begin;
+  counter = 0;
+
   Container<T> ranges;
   ranges.PUSH(std::make_pair(a, std::make_pair(begin, end)));
   quicksort_iterative_aux(ranges);
@@ -160,8 +596,10 @@ void quicksort_iterative_aux(Container<T>& ranges)
     unsigned e = 0;
     
     //check if container is empty before getting the triple
+    lock_wait_timer wait;
     sm.wait();
     containerLock.lock();
+    wait.Stop();
     //only if not empty then try to pop
     if (!ranges.empty())
     {
@@ -179,30 +617,29 @@ void quicksort_iterative_aux(Container<T>& ranges)
     }
 
     //base case
-    if (e - b < 6)
+    if (e - b <= small_sort_cutoff)
     {
       counter += e - b;
-      switch (e - b)
-      {
-      case 5: quicksort_base_5(a + b); break;
-      case 4: quicksort_base_4(a + b); break;
-      case 3: quicksort_base_3(a + b); break;
-      case 2: quicksort_base_2(a + b); break;
-      }
+      small_sort(a + b, e - b);
       sm.notify();
     }
     else
     {
-      unsigned q = partition(a, b, e);
-      ++counter;
+      unsigned lo, hi;
+      partition_adaptive(a, b, e, lo, hi);
+      counter += hi - lo;
 
+      lock_wait_timer waitLeft;
       containerLock.lock();
-      ranges.PUSH(std::make_pair(a, std::make_pair(b, q)));
+      waitLeft.Stop();
+      ranges.PUSH(std::make_pair(a, std::make_pair(b, lo)));
       containerLock.unlock();
       sm.notify();
 
+      lock_wait_timer waitRight;
       containerLock.lock();
-      ranges.PUSH(std::make_pair(a, std::make_pair(q + 1, e)));
+      waitRight.Stop();
+      ranges.PUSH(std::make_pair(a, std::make_pair(hi, e)));
       containerLock.unlock();
       sm.notify();
     }
@@ -212,17 +649,43 @@ void quicksort_iterative_aux(Container<T>& ranges)
 template< typename T>
 void quicksort(T* a, unsigned begin, unsigned end, int numThreads)
 {
-  //according to the tests provided 8 threads is the fastest to
-  //sort 200 ratios with delay
+  //integer and floating point keys are radix sorted, which needs no comparisons
+  if (quicksort_radix(a, begin, end, numThreads, std::integral_constant<bool, radix_traits<T>::enabled != 0>()))
+  {
+    return;
+  }
+  quicksort_tasks(a, begin, end, numThreads);
+}
+
+template< typename T>
+void quicksort_tasks(T* a, unsigned begin, unsigned end, int numThreads)
+{
+  //quicksort_bench.cpp measures thread counts per size and distribution,
+  //pick numThreads from its output
 
   //size of array
   arrSize = end - begin;
 
+  //the first levels are partitioned by all threads at once, the pivots they
+  //placed are done already
+  std::vector< std::pair<unsigned, unsigned> > top;
+  std::mutex topLock;
+  quicksort_top_levels(a, begin, end, numThreads, top, topLock);
+
   //create array of threads
   std::thread* threads = new std::thread[numThreads]();
 
   Container<T> ranges;
-  ranges.PUSH(std::make_pair(a, std::make_pair(begin, end)));
+  counter = arrSize;
+  for (size_t i = 0; i < top.size(); ++i)
+  {
+    ranges.PUSH(std::make_pair(a, top[i]));
+    counter -= top[i].second - top[i].first;
+    if (i)
+    {
+      sm.notify();
+    }
+  }
 
   //create threads
   for (int i = 0; i < numThreads; ++i)
@@ -238,4 +701,597 @@ void quicksort(T* a, unsigned begin, unsigned end, int numThreads)
 
   //delete array
   delete[] threads;
-}
\ No newline at end of file
+}
+
+/* work stealing */
+#include "chase_lev.h"
+
+//one task, fits the lock free atomics of the deque
+struct steal_range {
+  unsigned begin;
+  unsigned end;
+};
+
+//ranges below this are not worth a task, the thread holding them sorts them
+const unsigned steal_cutoff = 2048;
+
+//everything one sort shares between its threads, two sorts share nothing
+template< typename T>
+struct steal_state {
+  T* a;
+  int numThreads;
+  std::atomic<int> idle;    //threads holding no range with an empty deque
+  std::unique_ptr< ChaseLevDeque<steal_range>[] > deques;
+};
+
+template< typename T>
+void quicksort_stealing_push(steal_state<T>& state, ChaseLevDeque<steal_range>& own, unsigned b, unsigned e)
+{
+  if (e - b < 2) {
+    return;
+  }
+
+  steal_range r = { b, e };
+  if (e - b < steal_cutoff || !own.Push(r)) {
+    quicksort_rec(state.a, b, e);
+  }
+}
+
+//try every other deque once, starting at a random victim
+template< typename T>
+bool quicksort_stealing_steal(steal_state<T>& state, int self, unsigned& seed, steal_range& r)
+{
+  seed = seed * 1103515245u + 12345u;
+  int start = int((seed >> 16) % unsigned(state.numThreads));
+
+  for (int i = 0; i < state.numThreads; ++i) {
+    int victim = (start + i) % state.numThreads;
+    if (victim != self && state.deques[victim].Steal(r)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+template< typename T>
+void quicksort_stealing_aux(steal_state<T>& state, int self)
+{
+  ChaseLevDeque<steal_range>& own = state.deques[self];
+  unsigned seed = unsigned(self) * 2654435761u + 1;
+  steal_range r;
+
+  while (true)
+  {
+    if (!own.Pop(r) && !quicksort_stealing_steal(state, self, seed, r))
+    {
+      //a thread only counts itself idle with nothing in hand and an empty
+      //deque, and only the owner pushes, so once all threads are idle no
+      //range is left anywhere and the sort is done
+      ++state.idle;
+      bool found = false;
+      while (!found)
+      {
+        if (state.idle.load() == state.numThreads)
+        {
+          return;
+        }
+
+        bool visible = false;
+        for (int i = 0; i < state.numThreads && !visible; ++i)
+        {
+          visible = !state.deques[i].Empty();
+        }
+        if (!visible)
+        {
+          std::this_thread::yield();
+          continue;
+        }
+
+        //leave the idle count before taking work, so nobody sees everyone idle meanwhile
+        --state.idle;
+        found = quicksort_stealing_steal(state, self, seed, r);
+        if (!found)
+        {
+          ++state.idle;
+        }
+      }
+    }
+
+    unsigned lo, hi;
+    partition_adaptive(state.a, r.begin, r.end, lo, hi);
+
+    //the larger half goes in first, it is the oldest one and therefore the one
+    //thieves take, the owner carries on with the smaller half
+    if (lo - r.begin > r.end - hi)
+    {
+      quicksort_stealing_push(state, own, r.begin, lo);
+      quicksort_stealing_push(state, own, hi, r.end);
+    }
+    else
+    {
+      quicksort_stealing_push(state, own, hi, r.end);
+      quicksort_stealing_push(state, own, r.begin, lo);
+    }
+  }
+}
+
+//same result as quicksort, every thread works off its own deque and steals
+//from the others when it runs dry, there is no global state
+template< typename T>
+void quicksort_stealing(T* a, unsigned begin, unsigned end, int numThreads)
+{
+  if (numThreads < 1) {
+    numThreads = 1;
+  }
+
+  steal_state<T> state;
+  state.a = a;
+  state.numThreads = numThreads;
+  state.idle = 0;
+  state.deques.reset(new ChaseLevDeque<steal_range>[numThreads]);
+
+  //the top levels are partitioned by all threads together, the ranges they
+  //leave are dealt out over the deques before any worker runs
+  std::vector< std::pair<unsigned, unsigned> > top;
+  std::mutex topLock;
+  quicksort_top_levels(a, begin, end, numThreads, top, topLock);
+  for (size_t i = 0; i < top.size(); ++i)
+  {
+    quicksort_stealing_push(state, state.deques[i % numThreads], top[i].first, top[i].second);
+  }
+
+  std::vector<std::thread> threads;
+  for (int i = 1; i < numThreads; ++i)
+  {
+    threads.push_back(std::thread(quicksort_stealing_aux<T>, std::ref(state), i));
+  }
+
+  quicksort_stealing_aux(state, 0);
+
+  for (size_t i = 0; i < threads.size(); ++i)
+  {
+    threads[i].join();
+  }
+}
+
+/* sample sort */
+
+//below this sample sort and the multiway merge sort just run quicksort_rec
+const unsigned distribution_min = 1u << 14;
+
+//Parallel sample sort: splitters are taken from an oversampled, sorted set of
+//keys, every thread assigns its slice to buckets and the buckets are written
+//out as contiguous runs, one sequential pass in and one out, then whole
+//buckets are sorted with quicksort_rec and copied back
+template< typename T>
+void samplesort(T* a, unsigned begin, unsigned end, int numThreads)
+{
+  unsigned n = end - begin;
+  if (numThreads < 2 || n < distribution_min)
+  {
+    quicksort_rec(a, begin, end);
+    return;
+  }
+
+  a += begin;
+
+  //a few buckets per thread so the bucket sorts balance out
+  const unsigned buckets = unsigned(numThreads) * 4;
+  const unsigned oversample = 16;
+
+  std::vector<T> splitters;
+  {
+    std::vector<T> sample;
+    unsigned seed = n;
+    for (unsigned i = 0; i < buckets * oversample; ++i)
+    {
+      seed = seed * 1103515245u + 12345u;
+      sample.push_back(a[unsigned((unsigned long long)seed * n >> 32)]);
+    }
+    quicksort_rec(sample.data(), 0u, unsigned(sample.size()));
+    for (unsigned b = 1; b < buckets; ++b)
+    {
+      splitters.push_back(sample[b * oversample]);
+    }
+  }
+
+  std::vector<unsigned> first(numThreads + 1);
+  for (int t = 0; t <= numThreads; ++t)
+  {
+    first[t] = unsigned((unsigned long long)n * t / numThreads);
+  }
+
+  //bucket of every key, so the scatter pass does not search again
+  std::unique_ptr<unsigned short[]> bucket(new unsigned short[n]);
+  std::vector<unsigned> count(size_t(numThreads) * buckets, 0);
+
+  run_threads(numThreads, [&](int t) {
+    unsigned* c = &count[size_t(t) * buckets];
+    for (unsigned i = first[t]; i < first[t + 1]; ++i)
+    {
+      unsigned b = unsigned(std::upper_bound(splitters.begin(), splitters.end(), a[i]) - splitters.begin());
+      bucket[i] = (unsigned short)b;
+      ++c[b];
+    }
+  });
+
+  //bucket major, thread minor
+  std::vector<unsigned> bucketBegin(buckets + 1);
+  unsigned sum = 0;
+  for (unsigned b = 0; b < buckets; ++b)
+  {
+    bucketBegin[b] = sum;
+    for (int t = 0; t < numThreads; ++t)
+    {
+      unsigned& c = count[size_t(t) * buckets + b];
+      unsigned next = sum + c;
+      c = sum;
+      sum = next;
+    }
+  }
+  bucketBegin[buckets] = n;
+
+  std::unique_ptr<T[]> buffer(new T[n]);
+  run_threads(numThreads, [&](int t) {
+    unsigned* position = &count[size_t(t) * buckets];
+    for (unsigned i = first[t]; i < first[t + 1]; ++i)
+    {
+      buffer[position[bucket[i]]++] = a[i];
+    }
+  });
+
+  //threads take the next bucket until none is left
+  std::atomic<unsigned> next(0);
+  run_threads(numThreads, [&](int) {
+    for (unsigned b = next++; b < buckets; b = next++)
+    {
+      quicksort_rec(buffer.get(), bucketBegin[b], bucketBegin[b + 1]);
+      std::copy(buffer.get() + bucketBegin[b], buffer.get() + bucketBegin[b + 1], a + bucketBegin[b]);
+    }
+  });
+}
+
+/* multiway merge */
+
+//Merges sorted runs, the tree holds the loser of every match so replacing the
+//winner replays only the log k matches on its path to the root
+template< typename T>
+class loser_tree
+{
+public:
+  loser_tree(std::vector< std::pair<const T*, const T*> > const& Runs)
+    : runs(Runs), leaves(1), tree()
+  {
+    while (leaves < runs.size())
+    {
+      leaves <<= 1;
+    }
+    //empty runs pad the tree up to a power of two
+    runs.resize(leaves, std::make_pair((const T*)nullptr, (const T*)nullptr));
+    tree.resize(leaves);
+    tree[0] = Init(1);
+  }
+
+  bool empty() const
+  {
+    return Exhausted(tree[0]);
+  }
+
+  T const& top() const
+  {
+    return *runs[tree[0]].first;
+  }
+
+  void pop()
+  {
+    unsigned winner = tree[0];
+    ++runs[winner].first;
+    for (unsigned node = (winner + leaves) / 2; node > 0; node /= 2)
+    {
+      if (Less(tree[node], winner))
+      {
+        std::swap(tree[node], winner);
+      }
+    }
+    tree[0] = winner;
+  }
+
+private:
+  bool Exhausted(unsigned run) const
+  {
+    return runs[run].first == runs[run].second;
+  }
+
+  //ties go to the lower run, which keeps the merge stable
+  bool Less(unsigned lhs, unsigned rhs) const
+  {
+    if (Exhausted(lhs)) return false;
+    if (Exhausted(rhs)) return true;
+    if (*runs[rhs].first < *runs[lhs].first) return false;
+    if (*runs[lhs].first < *runs[rhs].first) return true;
+    return lhs < rhs;
+  }
+
+  //plays the matches below node, returns the winner and keeps the loser
+  unsigned Init(unsigned node)
+  {
+    if (node >= leaves)
+    {
+      return node - leaves;
+    }
+    unsigned left = Init(2 * node);
+    unsigned right = Init(2 * node + 1);
+    if (Less(right, left))
+    {
+      std::swap(left, right);
+    }
+    tree[node] = right;
+    return left;
+  }
+
+  std::vector< std::pair<const T*, const T*> > runs;
+  unsigned leaves;
+  std::vector<unsigned> tree;     //tree[0] is the overall winner
+};
+
+//Sorts numThreads chunks independently with quicksort_rec, then every thread
+//merges one slice of the output from all chunks with a loser tree. The slices
+//are cut at sampled keys, each chunk is split at the lower bound of the key,
+//so every thread reads k sequential streams and writes one.
+template< typename T>
+void multiway_mergesort(T* a, unsigned begin, unsigned end, int numThreads)
+{
+  unsigned n = end - begin;
+  if (numThreads < 2 || n < distribution_min)
+  {
+    quicksort_rec(a, begin, end);
+    return;
+  }
+
+  a += begin;
+
+  std::vector<unsigned> first(numThreads + 1);
+  for (int t = 0; t <= numThreads; ++t)
+  {
+    first[t] = unsigned((unsigned long long)n * t / numThreads);
+  }
+
+  run_threads(numThreads, [&](int t) {
+    quicksort_rec(a, first[t], first[t + 1]);
+  });
+
+  //output slice boundaries from evenly spaced keys of every sorted chunk
+  const unsigned oversample = 16;
+  std::vector<T> sample;
+  for (int t = 0; t < numThreads; ++t)
+  {
+    unsigned size = first[t + 1] - first[t];
+    for (unsigned s = 0; s < unsigned(numThreads) * oversample; ++s)
+    {
+      sample.push_back(a[first[t] + unsigned((unsigned long long)size * s / (numThreads * oversample))]);
+    }
+  }
+  quicksort_rec(sample.data(), 0u, unsigned(sample.size()));
+
+  //cut[s][c] is where slice s starts in chunk c
+  std::vector< std::vector<unsigned> > cut(numThreads + 1, std::vector<unsigned>(numThreads));
+  for (int c = 0; c < numThreads; ++c)
+  {
+    cut[0][c] = first[c];
+    cut[numThreads][c] = first[c + 1];
+    for (int s = 1; s < numThreads; ++s)
+    {
+      T const& key = sample[size_t(s) * sample.size() / numThreads];
+      cut[s][c] = unsigned(std::lower_bound(a + first[c], a + first[c + 1], key) - a);
+    }
+  }
+
+  std::unique_ptr<T[]> buffer(new T[n]);
+  std::vector<unsigned> output(numThreads + 1, 0);
+  for (int s = 0; s < numThreads; ++s)
+  {
+    output[s + 1] = output[s];
+    for (int c = 0; c < numThreads; ++c)
+    {
+      output[s + 1] += cut[s + 1][c] - cut[s][c];
+    }
+  }
+
+  run_threads(numThreads, [&](int s) {
+    std::vector< std::pair<const T*, const T*> > runs;
+    for (int c = 0; c < numThreads; ++c)
+    {
+      runs.push_back(std::make_pair(a + cut[s][c], a + cut[s + 1][c]));
+    }
+
+    loser_tree<T> tree(runs);
+    T* out = buffer.get() + output[s];
+    while (!tree.empty())
+    {
+      *out++ = tree.top();
+      tree.pop();
+    }
+  });
+
+  run_threads(numThreads, [&](int t) {
+    std::copy(buffer.get() + first[t], buffer.get() + first[t + 1], a + first[t]);
+  });
+}
+
+/* key and index */
+#include <functional>
+
+//key of one element and where the element is, ordered by the key alone;
+//operator< creates the comparator, so it is only used for empty ones
+template< typename K, typename Compare>
+struct key_index {
+  K key;
+  unsigned index;
+
+  bool operator<(key_index const& rhs) const { return Compare()(key, rhs.key); }
+};
+
+//pairs with arithmetic keys in ascending order can be radix sorted on the key
+template< typename K>
+struct radix_traits< key_index< K, std::less<K> >, typename std::enable_if< radix_traits<K>::enabled != 0 >::type > {
+  enum { enabled = 1 };
+  typedef typename radix_traits<K>::U U;
+  static U Key(key_index< K, std::less<K> > const& x) { return radix_traits<K>::Key(x.key); }
+};
+
+//an empty comparator fits operator<, the threaded quicksort takes the pairs
+template< typename P, typename Compare>
+void sort_pairs(P* pairs, unsigned n, int numThreads, Compare const&, std::true_type)
+{
+  quicksort(pairs, 0u, n, numThreads);
+}
+
+//a comparator with state stays out of the pairs: every thread sorts one chunk
+//with a lambda that holds it, then neighbouring chunks are merged, the merges
+//of one round in parallel
+template< typename P, typename Compare>
+void sort_pairs(P* pairs, unsigned n, int numThreads, Compare const& less, std::false_type)
+{
+  if (numThreads < 1)
+  {
+    numThreads = 1;
+  }
+
+  auto byKey = [&less](P const& lhs, P const& rhs) { return less(lhs.key, rhs.key); };
+  std::vector<unsigned> first(numThreads + 1);
+  for (int i = 0; i <= numThreads; ++i)
+  {
+    first[i] = unsigned((unsigned long long)n * i / numThreads);
+  }
+
+  run_threads(numThreads, [&](int t) {
+    std::sort(pairs + first[t], pairs + first[t + 1], byKey);
+  });
+
+  for (int width = 1; width < numThreads; width *= 2)
+  {
+    run_threads((numThreads + 2 * width - 1) / (2 * width), [&](int m) {
+      int left = 2 * m * width;
+      int middle = std::min(left + width, numThreads);
+      int right = std::min(left + 2 * width, numThreads);
+      std::inplace_merge(pairs + first[left], pairs + first[middle], pairs + first[right], byKey);
+    });
+  }
+}
+
+//index[i] becomes the position of the i-th smallest of keys[0 .. n), only the
+//compact (key, index) pairs are moved around by the threaded quicksort, which
+//radix sorts them when the keys are arithmetic and compared with std::less;
+//comparators with state sort the same pairs through sort_pairs
+template< typename K, typename Compare>
+void sort_index(const K* keys, unsigned n, int numThreads, unsigned* index, Compare less)
+{
+  typedef key_index<K, Compare> pair;
+  std::vector<pair> pairs;
+  pairs.reserve(n);
+  for (unsigned i = 0; i < n; ++i)
+  {
+    pair p = { keys[i], i };
+    pairs.push_back(p);
+  }
+
+  sort_pairs(pairs.data(), n, numThreads, less,
+    std::integral_constant<bool, std::is_empty<Compare>::value && std::is_default_constructible<Compare>::value>());
+
+  for (unsigned i = 0; i < n; ++i)
+  {
+    index[i] = pairs[i].index;
+  }
+}
+
+template< typename K>
+void sort_index(const K* keys, unsigned n, int numThreads, unsigned* index)
+{
+  sort_index(keys, n, numThreads, index, std::less<K>());
+}
+
+//column[i] = old column[index[i]], every element is moved twice: the reads
+//gather into uninitialised storage, which is moved back in order; each thread
+//takes one slice of the output, T needs no default constructor
+template< typename T>
+void permute(T* column, const unsigned* index, unsigned n, int numThreads)
+{
+  if (numThreads < 1)
+  {
+    numThreads = 1;
+  }
+
+  std::allocator<T> allocator;
+  T* sorted = allocator.allocate(n);
+  run_threads(numThreads, [&](int t) {
+    unsigned b = unsigned((unsigned long long)n * t / numThreads);
+    unsigned e = unsigned((unsigned long long)n * (t + 1) / numThreads);
+    for (unsigned i = b; i < e; ++i)
+    {
+      ::new (static_cast<void*>(sorted + i)) T(std::move(column[index[i]]));
+    }
+  });
+
+  run_threads(numThreads, [&](int t) {
+    unsigned b = unsigned((unsigned long long)n * t / numThreads);
+    unsigned e = unsigned((unsigned long long)n * (t + 1) / numThreads);
+    for (unsigned i = b; i < e; ++i)
+    {
+      column[i] = std::move(sorted[i]);
+      sorted[i].~T();
+    }
+  });
+  allocator.deallocate(sorted, n);
+}
+
+//struct of arrays, the same permutation for every column
+inline void permute_columns(const unsigned*, unsigned, int) {}
+
+template< typename T, typename... Columns>
+void permute_columns(const unsigned* index, unsigned n, int numThreads, T* column, Columns*... columns)
+{
+  permute(column, index, n, numThreads);
+  permute_columns(index, n, numThreads, columns...);
+}
+
+//sorts a[begin, end) by key(a[i]) in the order of less without moving whole
+//elements during the sort: the projected keys are sorted with their index,
+//then permute moves every element out and back; like quicksort it is not stable
+template< typename T, typename Key, typename Compare>
+void quicksort_by(T* a, unsigned begin, unsigned end, int numThreads, Key key, Compare less)
+{
+  typedef typename std::decay<decltype(key(*a))>::type K;
+  unsigned n = end - begin;
+
+  std::vector<K> keys;
+  keys.reserve(n);
+  for (unsigned i = begin; i < end; ++i)
+  {
+    keys.push_back(key(a[i]));
+  }
+
+  std::vector<unsigned> index(n);
+  sort_index(keys.data(), n, numThreads, index.data(), less);
+  permute(a + begin, index.data(), n, numThreads);
+}
+
+template< typename T, typename Key>
+void quicksort_by(T* a, unsigned begin, unsigned end, int numThreads, Key key)
+{
+  typedef typename std::decay<decltype(key(*a))>::type K;
+  quicksort_by(a, begin, end, numThreads, key, std::less<K>());
+}
+
+//whole elements ordered by less, the sort moves pointers to them
+template< typename T, typename Compare>
+struct pointee_less {
+  Compare less;
+  bool operator()(const T* lhs, const T* rhs) const { return less(*lhs, *rhs); }
+};
+
+template< typename T, typename Compare>
+void quicksort_compare(T* a, unsigned begin, unsigned end, int numThreads, Compare less)
+{
+  pointee_less<T, Compare> order = { less };
+  quicksort_by(a, begin, end, numThreads, [](T const& x) { return &x; }, order);
+}
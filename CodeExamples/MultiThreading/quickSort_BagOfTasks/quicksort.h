@@ -6,9 +6,36 @@ void quicksort_rec( T* a, unsigned begin, unsigned end );
 template< typename T>
 void quicksort_iterative( T* a, unsigned begin, unsigned end );
 
+//radix sorts integer and floating point arrays, runs quicksort_tasks otherwise
 template< typename T>
 void quicksort(T* a, unsigned, unsigned, int);
 
+//the bag of tasks quicksort for any type with operator<
+template< typename T>
+void quicksort_tasks(T* a, unsigned begin, unsigned end, int numThreads);
+
+//work stealing version of quicksort, safe to run several at once
+template< typename T>
+void quicksort_stealing(T* a, unsigned begin, unsigned end, int numThreads);
+
+//parallel sample sort, buckets are sorted with quicksort_rec
+template< typename T>
+void samplesort(T* a, unsigned begin, unsigned end, int numThreads);
+
+//chunks sorted with quicksort_rec, then a parallel k-way merge
+template< typename T>
+void multiway_mergesort(T* a, unsigned begin, unsigned end, int numThreads);
+
+//sorts by a key projection and a comparator on keys, elements are only moved
+//by the final permutation
+template< typename T, typename Key, typename Compare>
+void quicksort_by(T* a, unsigned begin, unsigned end, int numThreads, Key key, Compare less);
+
+//sorts whole elements with a comparator, elements are only moved by the final
+//permutation
+template< typename T, typename Compare>
+void quicksort_compare(T* a, unsigned begin, unsigned end, int numThreads, Compare less);
+
 #include "quicksort.cpp"
 #endif
 
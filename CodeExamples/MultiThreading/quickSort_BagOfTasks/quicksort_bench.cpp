@@ -0,0 +1,266 @@
+//Quicksort benchmark, runs every sort over a grid of element types, input
+//distributions, sizes and thread counts and prints one CSV row per run
+//build: g++ -O2 -march=native -std=c++17 -pthread quicksort_bench.cpp -o quicksort_bench -ltbb
+//libstdc++ runs std::execution::par on TBB, without TBB installed build with
+//-DNO_STD_PAR instead of -ltbb to leave the std_sort_par baseline out
+//usage: quicksort_bench [-s 1000,65536,1048576] [-t 1,2,4,8] [-d random,sorted,...] [-y int,float,...] [-r repeats]
+#define QUICKSORT_LOCK_STATS
+#include "quicksort.h"
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#if !defined(NO_STD_PAR) && __has_include(<execution>)
+#include <execution>
+#if defined(__cpp_lib_execution) || defined(__cpp_lib_parallel_algorithm)
+#define STD_PAR
+#endif
+#endif
+
+struct Options
+{
+  std::vector<unsigned> sizes;
+  std::vector<int> threads;
+  std::vector<std::string> distributions;
+  std::vector<std::string> types;
+  int repeats;
+};
+
+std::vector<std::string> Split(const char* text)
+{
+  std::vector<std::string> items;
+  std::stringstream stream(text);
+  std::string item;
+  while (std::getline(stream, item, ','))
+  {
+    items.push_back(item);
+  }
+  return items;
+}
+
+//keys in [0, n) before they are converted to the element type
+std::vector<long long> MakeKeys(const std::string& distribution, unsigned n)
+{
+  std::vector<long long> keys(n);
+  std::mt19937_64 rng(n);
+
+  if (distribution == "sorted" || distribution == "reversed")
+  {
+    for (unsigned i = 0; i < n; ++i)
+    {
+      keys[i] = distribution == "sorted" ? i : n - 1 - i;
+    }
+  }
+  else if (distribution == "organpipe")
+  {
+    for (unsigned i = 0; i < n; ++i)
+    {
+      keys[i] = i < n / 2 ? i : n - 1 - i;
+    }
+  }
+  else if (distribution == "fewunique")
+  {
+    for (unsigned i = 0; i < n; ++i)
+    {
+      keys[i] = (long long)(rng() % 16) * (n / 16 + 1);
+    }
+  }
+  else if (distribution == "zipf")
+  {
+    //s = 1 over up to 2^20 ranks, drawn through the cumulative distribution
+    unsigned ranks = std::max(1u, std::min(n, 1u << 20));
+    std::vector<double> cumulative(ranks);
+    double sum = 0.0;
+    for (unsigned r = 0; r < ranks; ++r)
+    {
+      sum += 1.0 / (r + 1);
+      cumulative[r] = sum;
+    }
+    std::uniform_real_distribution<double> uniform(0.0, sum);
+    for (unsigned i = 0; i < n; ++i)
+    {
+      keys[i] = std::lower_bound(cumulative.begin(), cumulative.end(), uniform(rng)) - cumulative.begin();
+    }
+  }
+  else
+  {
+    for (unsigned i = 0; i < n; ++i)
+    {
+      keys[i] = (long long)(rng() % (unsigned long long)std::max(n, 1u << 30));
+    }
+  }
+
+  return keys;
+}
+
+struct Result
+{
+  double seconds;
+  double lockWaitMs;
+  bool sorted;
+};
+
+template <typename T>
+Result Measure(const std::string& engine, int threads, const std::vector<T>& input)
+{
+  std::vector<T> data(input);
+  T* a = data.data();
+  unsigned n = unsigned(data.size());
+  lockWaitNanos = 0;
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  if (engine == "rec") quicksort_rec(a, 0u, n);
+  else if (engine == "iterative") quicksort_iterative(a, 0u, n);
+  else if (engine == "quicksort") quicksort(a, 0u, n, threads);
+  else if (engine == "tasks") quicksort_tasks(a, 0u, n, threads);
+  else if (engine == "stealing") quicksort_stealing(a, 0u, n, threads);
+  else if (engine == "samplesort") samplesort(a, 0u, n, threads);
+  else if (engine == "mergesort") multiway_mergesort(a, 0u, n, threads);
+  else if (engine == "std_sort") std::sort(data.begin(), data.end());
+#ifdef STD_PAR
+  else if (engine == "std_sort_par") std::sort(std::execution::par, data.begin(), data.end());
+#endif
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+  Result result;
+  result.seconds = std::chrono::duration<double>(end - start).count();
+  result.lockWaitMs = lockWaitNanos.load() / 1e6;
+  result.sorted = std::is_sorted(data.begin(), data.end());
+  return result;
+}
+
+template <typename T>
+void RunType(const std::string& type, const Options& options)
+{
+  //engines that take a thread count, the rest run once with one thread
+  const char* threaded[] = { "quicksort", "tasks", "stealing", "samplesort", "mergesort" };
+  std::vector<std::string> single;
+  single.push_back("rec");
+  single.push_back("iterative");
+  single.push_back("std_sort");
+#ifdef STD_PAR
+  single.push_back("std_sort_par");
+#endif
+
+  for (size_t s = 0; s < options.sizes.size(); ++s)
+  {
+    unsigned n = options.sizes[s];
+    for (size_t d = 0; d < options.distributions.size(); ++d)
+    {
+      std::vector<long long> keys = MakeKeys(options.distributions[d], n);
+      std::vector<T> input(keys.begin(), keys.end());
+      keys.clear();
+      keys.shrink_to_fit();
+
+      //every engine and thread count pair, the best of the repeats is reported
+      std::vector< std::pair<std::string, int> > runs;
+      for (size_t e = 0; e < single.size(); ++e)
+      {
+        runs.push_back(std::make_pair(single[e], 1));
+      }
+      for (size_t e = 0; e < sizeof(threaded) / sizeof(threaded[0]); ++e)
+      {
+        for (size_t t = 0; t < options.threads.size(); ++t)
+        {
+          runs.push_back(std::make_pair(std::string(threaded[e]), options.threads[t]));
+        }
+      }
+
+      //speedup is against the same engine at the first thread count
+      std::string baseEngine;
+      double baseSeconds = 0.0;
+
+      for (size_t r = 0; r < runs.size(); ++r)
+      {
+        Result best = Measure<T>(runs[r].first, runs[r].second, input);
+        for (int repeat = 1; repeat < options.repeats; ++repeat)
+        {
+          Result result = Measure<T>(runs[r].first, runs[r].second, input);
+          if (result.seconds < best.seconds)
+          {
+            best = result;
+          }
+          best.sorted = best.sorted && result.sorted;
+        }
+
+        if (runs[r].first != baseEngine)
+        {
+          baseEngine = runs[r].first;
+          baseSeconds = best.seconds;
+        }
+
+        std::cout << runs[r].first << ','
+          << type << ','
+          << options.distributions[d] << ','
+          << n << ','
+          << runs[r].second << ','
+          << best.seconds << ','
+          << (best.seconds > 0.0 ? n / best.seconds : 0.0) << ','
+          << (best.seconds > 0.0 ? baseSeconds / best.seconds : 0.0) << ','
+          << best.lockWaitMs << ','
+          << (best.sorted ? "yes" : "no") << std::endl;
+      }
+    }
+  }
+}
+
+int main(int argc, char** argv)
+{
+  Options options;
+  options.threads.push_back(1);
+  options.threads.push_back(2);
+  options.threads.push_back(4);
+  options.threads.push_back(8);
+  options.distributions = Split("random,sorted,reversed,organpipe,fewunique,zipf");
+  options.types = Split("int,int64,float,double");
+  options.repeats = 3;
+
+  std::vector<std::string> sizes = Split("1000,65536,1048576,16777216");
+
+  for (int i = 1; i + 1 < argc; i += 2)
+  {
+    if (!std::strcmp(argv[i], "-s")) sizes = Split(argv[i + 1]);
+    else if (!std::strcmp(argv[i], "-d")) options.distributions = Split(argv[i + 1]);
+    else if (!std::strcmp(argv[i], "-y")) options.types = Split(argv[i + 1]);
+    else if (!std::strcmp(argv[i], "-r")) options.repeats = std::max(1, std::atoi(argv[i + 1]));
+    else if (!std::strcmp(argv[i], "-t"))
+    {
+      std::vector<std::string> threads = Split(argv[i + 1]);
+      options.threads.clear();
+      for (size_t t = 0; t < threads.size(); ++t)
+      {
+        options.threads.push_back(std::max(1, std::atoi(threads[t].c_str())));
+      }
+    }
+    else
+    {
+      std::cerr << "unknown option " << argv[i] << std::endl;
+      return 1;
+    }
+  }
+
+  for (size_t s = 0; s < sizes.size(); ++s)
+  {
+    options.sizes.push_back(unsigned(std::strtoul(sizes[s].c_str(), nullptr, 10)));
+  }
+
+  std::cout << "engine,type,distribution,size,threads,seconds,elements_per_sec,speedup,lock_wait_ms,sorted" << std::endl;
+
+  for (size_t y = 0; y < options.types.size(); ++y)
+  {
+    const std::string& type = options.types[y];
+    if (type == "int") RunType<int>(type, options);
+    else if (type == "int64") RunType<long long>(type, options);
+    else if (type == "float") RunType<float>(type, options);
+    else if (type == "double") RunType<double>(type, options);
+    else std::cerr << "unknown type " << type << std::endl;
+  }
+
+  return 0;
+}
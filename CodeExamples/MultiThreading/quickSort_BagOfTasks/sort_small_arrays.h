@@ -0,0 +1,266 @@
+#ifndef SORT_SMALL_ARRAYS_H
+#define SORT_SMALL_ARRAYS_H
+#include <limits>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+//Sorting networks for the leaves of quicksort
+//
+//small_sort(a, n) sorts up to small_sort_max keys. The comparisons of a network
+//do not depend on the keys, and each compare exchange is a min and a max,
+//which compilers turn into conditional moves for arithmetic types.
+//With AVX2, int and float ranges of 5 to 16 keys are padded to 8 or 16 lanes
+//and sorted inside one or two registers by a bitonic network.
+//Only operator< is used, a compare exchange of equal keys keeps both.
+
+const unsigned small_sort_max = 32;
+
+template <typename T>
+inline void compare_exchange(T& a, T& b)
+{
+  bool swap = b < a;
+  T lo = swap ? b : a;
+  T hi = swap ? a : b;
+  a = lo;
+  b = hi;
+}
+
+//Batcher's merge exchange network for N keys (Knuth, TAOCP 5.2.2 algorithm M)
+template <typename T, unsigned N>
+struct sort_network
+{
+  static void Sort(T* a)
+  {
+    unsigned top = 1;
+    while (top < N)
+    {
+      top <<= 1;
+    }
+    top >>= 1;
+
+    for (unsigned p = top; p > 0; p >>= 1)
+    {
+      unsigned q = top, r = 0, d = p;
+      while (true)
+      {
+        for (unsigned i = 0; i + d < N; ++i)
+        {
+          if ((i & p) == r)
+          {
+            compare_exchange(a[i], a[i + d]);
+          }
+        }
+        if (q == p)
+        {
+          break;
+        }
+        d = q - p;
+        q >>= 1;
+        r = p;
+      }
+    }
+  }
+};
+
+template <typename T>
+struct sort_network<T, 0>
+{
+  static void Sort(T*) {}
+};
+
+template <typename T>
+struct sort_network<T, 1>
+{
+  static void Sort(T*) {}
+};
+
+//calls the network for n, N is the largest size it knows about
+template <typename T, unsigned N>
+struct sort_network_switch
+{
+  static void Sort(T* a, unsigned n)
+  {
+    if (n == N)
+    {
+      sort_network<T, N>::Sort(a);
+    }
+    else
+    {
+      sort_network_switch<T, N - 1>::Sort(a, n);
+    }
+  }
+};
+
+template <typename T>
+struct sort_network_switch<T, 1>
+{
+  static void Sort(T*, unsigned) {}
+};
+
+template <typename T>
+struct small_sort_simd
+{
+  enum { enabled = 0 };
+  static void Sort(T*, unsigned) {}
+};
+
+#ifdef __AVX2__
+
+struct small_sort_ops_int
+{
+  typedef int T;
+  typedef __m256i V;
+
+  static V Load(const T* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+  static void Store(T* p, V v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+  static V Min(V a, V b) { return _mm256_min_epi32(a, b); }
+  static V Max(V a, V b) { return _mm256_max_epi32(a, b); }
+  static V Permute(V v, __m256i index) { return _mm256_permutevar8x32_epi32(v, index); }
+  //blendvps on the lane's sign bit, GCC 12 folds a constant blendv_epi8 mask
+  //wrongly once AVX-512BW is enabled (-march=native on recent CPUs)
+  static V Select(V lo, V hi, __m256i upper)
+  {
+    return _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(lo), _mm256_castsi256_ps(hi), _mm256_castsi256_ps(upper)));
+  }
+  static T Padding() { return std::numeric_limits<T>::max(); }
+};
+
+struct small_sort_ops_float
+{
+  typedef float T;
+  typedef __m256 V;
+
+  static V Load(const T* p) { return _mm256_loadu_ps(p); }
+  static void Store(T* p, V v) { _mm256_storeu_ps(p, v); }
+  //minps and maxps return their second operand on ties and NaNs, which is
+  //always the lane's own key here, so no key is lost
+  static V Min(V a, V b) { return _mm256_min_ps(a, b); }
+  static V Max(V a, V b) { return _mm256_max_ps(a, b); }
+  static V Permute(V v, __m256i index) { return _mm256_permutevar8x32_ps(v, index); }
+  static V Select(V lo, V hi, __m256i upper) { return _mm256_blendv_ps(lo, hi, _mm256_castsi256_ps(upper)); }
+  static T Padding() { return std::numeric_limits<T>::infinity(); }
+};
+
+//one step of the bitonic network over lanes base .. base + 7: every lane meets
+//the lane j away, blocks of k lanes alternate between ascending and descending
+template <typename Ops>
+inline typename Ops::V bitonic_step(typename Ops::V v, int base, int k, int j)
+{
+  int index[8], upper[8];
+  for (int lane = 0; lane < 8; ++lane)
+  {
+    int i = base + lane;
+    bool ascending = (i & k) == 0;
+    index[lane] = lane ^ j;
+    upper[lane] = ((i & j) != 0) == ascending ? -1 : 0;
+  }
+
+  typename Ops::V other = Ops::Permute(v, _mm256_setr_epi32(index[0], index[1], index[2], index[3], index[4], index[5], index[6], index[7]));
+  return Ops::Select(Ops::Min(other, v), Ops::Max(other, v),
+    _mm256_setr_epi32(upper[0], upper[1], upper[2], upper[3], upper[4], upper[5], upper[6], upper[7]));
+}
+
+//sorts 8 lanes, ascending when bit 3 of base is clear and descending otherwise
+template <typename Ops>
+inline typename Ops::V bitonic_sort8(typename Ops::V v, int base)
+{
+  for (int k = 2; k <= 8; k <<= 1)
+  {
+    for (int j = k >> 1; j > 0; j >>= 1)
+    {
+      v = bitonic_step<Ops>(v, base, k, j);
+    }
+  }
+  return v;
+}
+
+template <typename Ops>
+inline void small_sort_registers(typename Ops::T* a, unsigned n)
+{
+  typedef typename Ops::T T;
+  typedef typename Ops::V V;
+
+  T keys[16];
+  for (unsigned i = 0; i < n; ++i)
+  {
+    keys[i] = a[i];
+  }
+  for (unsigned i = n; i < 16; ++i)
+  {
+    keys[i] = Ops::Padding();
+  }
+
+  if (n <= 8)
+  {
+    Ops::Store(keys, bitonic_sort8<Ops>(Ops::Load(keys), 0));
+  }
+  else
+  {
+    //first half ascending, second half descending, then one bitonic merge
+    V lo = bitonic_sort8<Ops>(Ops::Load(keys), 0);
+    V hi = bitonic_sort8<Ops>(Ops::Load(keys + 8), 8);
+    V min = Ops::Min(hi, lo);
+    V max = Ops::Max(lo, hi);
+    for (int j = 4; j > 0; j >>= 1)
+    {
+      min = bitonic_step<Ops>(min, 0, 16, j);
+      max = bitonic_step<Ops>(max, 8, 16, j);
+    }
+    Ops::Store(keys, min);
+    Ops::Store(keys + 8, max);
+  }
+
+  for (unsigned i = 0; i < n; ++i)
+  {
+    a[i] = keys[i];
+  }
+}
+
+template <>
+struct small_sort_simd<int>
+{
+  enum { enabled = 1 };
+  static void Sort(int* a, unsigned n) { small_sort_registers<small_sort_ops_int>(a, n); }
+};
+
+template <>
+struct small_sort_simd<float>
+{
+  enum { enabled = 1 };
+  static void Sort(float* a, unsigned n) { small_sort_registers<small_sort_ops_float>(a, n); }
+};
+
+#endif
+
+//sorts a[0 .. n), n at most small_sort_max
+template <typename T>
+inline void small_sort(T* a, unsigned n)
+{
+  if (small_sort_simd<T>::enabled && n > 4 && n <= 16)
+  {
+    small_sort_simd<T>::Sort(a, n);
+    return;
+  }
+  sort_network_switch<T, small_sort_max>::Sort(a, n);
+}
+
+//fixed size base cases
+template <typename T> void quicksort_base_2(T* a) { sort_network<T, 2>::Sort(a); }
+template <typename T> void quicksort_base_3(T* a) { sort_network<T, 3>::Sort(a); }
+template <typename T> void quicksort_base_4(T* a) { sort_network<T, 4>::Sort(a); }
+template <typename T> void quicksort_base_5(T* a) { sort_network<T, 5>::Sort(a); }
+
+//sorts the keys five pointers point to, the pointers stay where they are
+template <typename T>
+void quicksort_base_5_pointers(T** p)
+{
+  T keys[5] = { *p[0], *p[1], *p[2], *p[3], *p[4] };
+  sort_network<T, 5>::Sort(keys);
+  for (int i = 0; i < 5; ++i)
+  {
+    *p[i] = keys[i];
+  }
+}
+
+#endif
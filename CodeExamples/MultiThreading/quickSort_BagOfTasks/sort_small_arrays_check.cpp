@@ -0,0 +1,56 @@
+//Checks small_sort against std::sort for every size up to small_sort_max
+//the vector paths depend on the target, so build and run it once per flag set:
+//build: g++ -O2 -std=c++17 sort_small_arrays_check.cpp -o sort_small_arrays_check
+//build: g++ -O2 -mavx2 -std=c++17 sort_small_arrays_check.cpp -o sort_small_arrays_check
+//build: g++ -O2 -march=native -std=c++17 sort_small_arrays_check.cpp -o sort_small_arrays_check
+//-march=native matters on its own, GCC 12 once miscompiled the int lane blend
+//only when AVX-512BW was enabled
+//usage: sort_small_arrays_check [arrays per size], exits with 1 on a mismatch
+#include "sort_small_arrays.h"
+#include <iostream>
+#include <random>
+#include <algorithm>
+#include <cstdlib>
+
+template <typename T>
+bool Check(const char* type, int arrays)
+{
+  std::mt19937 rng(7);
+  T keys[small_sort_max], expected[small_sort_max];
+
+  for (unsigned n = 0; n <= small_sort_max; ++n)
+  {
+    for (int i = 0; i < arrays; ++i)
+    {
+      //every other array draws from few values so equal keys are covered
+      unsigned range = i & 1 ? 4 : 1000;
+      for (unsigned k = 0; k < n; ++k)
+      {
+        keys[k] = expected[k] = T(int(rng() % range) - int(range / 2));
+      }
+
+      small_sort(keys, n);
+      std::sort(expected, expected + n);
+      if (!std::equal(keys, keys + n, expected))
+      {
+        std::cout << type << " n=" << n << " array " << i << " not sorted" << std::endl;
+        return false;
+      }
+    }
+  }
+
+  std::cout << type << " ok" << std::endl;
+  return true;
+}
+
+int main(int argc, char** argv)
+{
+  int arrays = argc > 1 ? std::max(1, std::atoi(argv[1])) : 2000;
+
+  bool ok = Check<int>("int", arrays);
+  ok = Check<float>("float", arrays) && ok;
+  ok = Check<double>("double", arrays) && ok;
+  ok = Check<short>("short", arrays) && ok;
+
+  return ok ? 0 : 1;
+}
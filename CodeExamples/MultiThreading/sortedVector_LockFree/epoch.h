@@ -0,0 +1,249 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+#include <atomic>         // std::atomic
+#include <vector>         // std::vector
+#include <mutex>          // std::mutex
+#include <cstdint>        // uint64_t
+#include <cstddef>        // size_t
+
+//Epoch based memory reclamation, shared by every lock free container in the process
+//
+//A thread reads shared pointers only inside an Epoch::Guard, which announces
+//the global epoch it started in. Memory that was unlinked is handed to Retire
+//and freed once the global epoch moved twice past the epoch it was retired in,
+//by then no guard that could have seen it is still active.
+//Every thread keeps one record (announcement plus its own retired list),
+//records of finished threads are reused, so memory held back is bounded by
+//a few retired objects per thread.
+class Epoch
+{
+  struct Record;
+public:
+  //RAII critical section, guards nest
+  class Guard
+  {
+  public:
+    Guard() : record(Enter()) {}
+    Guard(const Guard&) : record(Enter()) {}
+    ~Guard() { Exit(record); }
+  private:
+    Guard& operator=(const Guard&);
+    Record* record;
+  };
+
+  //free p with deleter once no guard can reach it
+  static void Retire(void* p, void (*deleter)(void*))
+  {
+    Record* record = Local().record;
+    record->retired.push_back(Retired(p, deleter, Global().epoch.load()));
+    ++Global().pending;
+
+    if (record->retired.size() >= RetireBatch)
+    {
+      Collect(record);
+    }
+  }
+
+  template <typename T>
+  static void Retire(T* p)
+  {
+    Retire(const_cast<void*>(static_cast<const void*>(p)), &DeleteObject<T>);
+  }
+
+  //objects retired but not freed yet, over all threads
+  static size_t Pending()
+  {
+    return Global().pending.load();
+  }
+
+  //free everything this thread retired that is safe to free now
+  static void Collect()
+  {
+    Collect(Local().record);
+  }
+
+private:
+  //a thread tries to advance the epoch after this many retires
+  static const size_t RetireBatch = 4;
+
+  struct Retired
+  {
+    Retired(void* P, void (*Deleter)(void*), uint64_t Epoch) : p(P), deleter(Deleter), epoch(Epoch) {}
+    void* p;
+    void (*deleter)(void*);
+    uint64_t epoch;
+  };
+
+  struct alignas(64) Record
+  {
+    Record() : epoch(0), used(true), next(nullptr), nesting(0), retired() {}
+    std::atomic<uint64_t> epoch;      //0 when the thread is outside of a guard
+    std::atomic<bool> used;
+    Record* next;
+    int nesting;
+    std::vector<Retired> retired;
+  };
+
+  struct Domain
+  {
+    Domain() : epoch(1), records(nullptr), pending(0), orphans(), lock() {}
+
+    //no threads are left at exit, everything can go
+    ~Domain()
+    {
+      Free(orphans, ~uint64_t(0));
+      Record* record = records.load();
+      while (record)
+      {
+        Record* next = record->next;
+        Free(record->retired, ~uint64_t(0));
+        delete record;
+        record = next;
+      }
+    }
+
+    std::atomic<uint64_t> epoch;
+    std::atomic<Record*> records;
+    std::atomic<size_t> pending;
+    std::vector<Retired> orphans;     //left behind by threads that exited
+    std::mutex lock;
+  };
+
+  //owns the record of one thread, hands it back when the thread exits
+  struct Owner
+  {
+    Owner() : record(Acquire()) {}
+    ~Owner()
+    {
+      Domain& domain = Global();
+      domain.lock.lock();
+      domain.orphans.insert(domain.orphans.end(), record->retired.begin(), record->retired.end());
+      domain.lock.unlock();
+
+      record->retired.clear();
+      record->epoch.store(0);
+      record->used.store(false);
+    }
+    Record* record;
+  };
+
+  template <typename T>
+  static void DeleteObject(void* p)
+  {
+    delete static_cast<T*>(p);
+  }
+
+  static Domain& Global()
+  {
+    static Domain domain;
+    return domain;
+  }
+
+  static Owner& Local()
+  {
+    static thread_local Owner owner;
+    return owner;
+  }
+
+  //reuse the record of a finished thread or add a new one
+  static Record* Acquire()
+  {
+    Domain& domain = Global();
+    for (Record* record = domain.records.load(); record; record = record->next)
+    {
+      bool free = false;
+      if (!record->used.load() && record->used.compare_exchange_strong(free, true))
+      {
+        return record;
+      }
+    }
+
+    Record* record = new Record();
+    Record* head = domain.records.load();
+    do
+    {
+      record->next = head;
+    } while (!domain.records.compare_exchange_weak(head, record));
+    return record;
+  }
+
+  static Record* Enter()
+  {
+    Record* record = Local().record;
+    if (record->nesting++ == 0)
+    {
+      //the announcement must be visible before any shared pointer is read; a
+      //seq_cst store alone does not order the acquire loads after it, the
+      //fence does (it pairs with the one in Collect)
+      record->epoch.store(Global().epoch.load());
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+    return record;
+  }
+
+  static void Exit(Record* record)
+  {
+    if (--record->nesting == 0)
+    {
+      record->epoch.store(0, std::memory_order_release);
+    }
+  }
+
+  //free retired objects from epochs older than safe
+  static void Free(std::vector<Retired>& retired, uint64_t safe)
+  {
+    size_t kept = 0;
+    size_t size = retired.size();
+    for (size_t i = 0; i < size; ++i)
+    {
+      if (retired[i].epoch < safe)
+      {
+        retired[i].deleter(retired[i].p);
+        --Global().pending;
+      }
+      else
+      {
+        retired[kept++] = retired[i];
+      }
+    }
+    retired.erase(retired.begin() + kept, retired.end());
+  }
+
+  static void Collect(Record* self)
+  {
+    //orders the unlinking CAS before the scan of the announcements, see Enter
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    Domain& domain = Global();
+    uint64_t epoch = domain.epoch.load();
+
+    //the epoch can move on once every active thread has seen the current one
+    bool advance = true;
+    for (Record* record = domain.records.load(); record; record = record->next)
+    {
+      uint64_t announced = record->epoch.load();
+      if (announced && announced != epoch)
+      {
+        advance = false;
+        break;
+      }
+    }
+
+    if (advance && domain.epoch.compare_exchange_strong(epoch, epoch + 1))
+    {
+      ++epoch;
+    }
+
+    //retired in epoch e is safe once the global epoch reached e + 2
+    uint64_t safe = epoch - 1;
+    Free(self->retired, safe);
+
+    if (domain.lock.try_lock())
+    {
+      Free(domain.orphans, safe);
+      domain.lock.unlock();
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,441 @@
+#include <atomic>         // std::atomic
+#include <vector>         // std::vector
+#include <algorithm>      // std::lower_bound
+#include <cstddef>        // size_t
+#include "epoch.h"        // Epoch
+
+//Lock free sorted tree, same interface as LFSV plus rank, lower_bound and snapshots
+//
+//The data is a persistent B+tree: a version is never modified once published.
+//Insert copies only the root to leaf path it changes (O(log n) nodes) and
+//publishes the new root with a single CAS. A failed CAS keeps the copies below
+//the lowest node another insert replaced and only copies the levels above it,
+//so writers racing on different leaves redo a node or two, not the whole path.
+//Inner nodes keep cumulative subtree sizes, so positional reads and rank
+//queries are O(log n) and are exact for the version they start from.
+//Replaced nodes are retired to the epoch collector (epoch.h).
+class LFST
+{
+public:
+  enum { LeafCapacity = 64, Fanout = 32, MaxDepth = 16 };
+
+  struct Node
+  {
+    bool leaf;
+    int count;          //keys in a leaf, children in an inner node
+  };
+
+  struct Leaf : Node
+  {
+    int keys[LeafCapacity];
+  };
+
+  struct Inner : Node
+  {
+    int firstKey[Fanout];       //smallest key under each child
+    size_t end[Fanout];         //elements under children 0..i
+    const Node* child[Fanout];
+  };
+
+  //one immutable version of the container, it keeps its epoch guard for as
+  //long as it lives, so it must stay on the thread that took it
+  class Version
+  {
+  public:
+    class const_iterator
+    {
+    public:
+      const_iterator() : depth(0) {}
+
+      int operator*() const
+      {
+        return static_cast<const Leaf*>(path[depth - 1])->keys[index[depth - 1]];
+      }
+
+      const_iterator& operator++()
+      {
+        ++index[depth - 1];
+        Normalize();
+        return *this;
+      }
+
+      bool operator==(const const_iterator& rhs) const
+      {
+        if (depth != rhs.depth)
+        {
+          return false;
+        }
+        return !depth || (path[depth - 1] == rhs.path[depth - 1] && index[depth - 1] == rhs.index[depth - 1]);
+      }
+
+      bool operator!=(const const_iterator& rhs) const { return !(*this == rhs); }
+
+    private:
+      friend class Version;
+
+      void Push(const Node* node, int i)
+      {
+        path[depth] = node;
+        index[depth] = i;
+        ++depth;
+      }
+
+      //walk down to the leftmost leaf below the top of the stack
+      void Descend()
+      {
+        while (!path[depth - 1]->leaf)
+        {
+          const Inner* inner = static_cast<const Inner*>(path[depth - 1]);
+          Push(inner->child[index[depth - 1]], 0);
+        }
+      }
+
+      //if the leaf position ran off the end move to the next leaf, empty stack is end()
+      void Normalize()
+      {
+        while (depth && index[depth - 1] >= path[depth - 1]->count)
+        {
+          --depth;
+          if (depth)
+          {
+            ++index[depth - 1];
+          }
+        }
+
+        if (depth)
+        {
+          Descend();
+        }
+      }
+
+      const Node* path[MaxDepth];
+      int index[MaxDepth];
+      int depth;
+    };
+
+    Version(const std::atomic<const Node*>& Root) : guard(), root(Root.load(std::memory_order_acquire)) {}
+
+    size_t size() const { return Size(root); }
+
+    int operator[] (size_t pos) const
+    {
+      const Node* node = root;
+      while (!node->leaf)
+      {
+        const Inner* inner = static_cast<const Inner*>(node);
+        int i = int(std::upper_bound(inner->end, inner->end + inner->count, pos) - inner->end);
+        if (i)
+        {
+          pos -= inner->end[i - 1];
+        }
+        node = inner->child[i];
+      }
+      return static_cast<const Leaf*>(node)->keys[pos];
+    }
+
+    //number of elements less than v, which is also the position of lower_bound(v)
+    size_t Rank(int v) const
+    {
+      size_t rank = 0;
+      const Node* node = root;
+      while (!node->leaf)
+      {
+        const Inner* inner = static_cast<const Inner*>(node);
+        int i = ChildFor(inner, v);
+        if (i)
+        {
+          rank += inner->end[i - 1];
+        }
+        node = inner->child[i];
+      }
+
+      const Leaf* leaf = static_cast<const Leaf*>(node);
+      return rank + (std::lower_bound(leaf->keys, leaf->keys + leaf->count, v) - leaf->keys);
+    }
+
+    const_iterator begin() const
+    {
+      const_iterator it;
+      it.Push(root, 0);
+      it.Normalize();
+      return it;
+    }
+
+    const_iterator end() const { return const_iterator(); }
+
+    //first element not less than v
+    const_iterator lower_bound(int v) const
+    {
+      const_iterator it;
+      const Node* node = root;
+      while (!node->leaf)
+      {
+        const Inner* inner = static_cast<const Inner*>(node);
+        int i = ChildFor(inner, v);
+        it.Push(node, i);
+        node = inner->child[i];
+      }
+
+      const Leaf* leaf = static_cast<const Leaf*>(node);
+      it.Push(node, int(std::lower_bound(leaf->keys, leaf->keys + leaf->count, v) - leaf->keys));
+      it.Normalize();
+      return it;
+    }
+
+  private:
+    Epoch::Guard guard;   //taken before root is read
+    const Node* root;
+  };
+
+  LFST() : root(MakeLeaf(nullptr, 0)), casRetries(0)
+  {}
+
+  ~LFST()
+  {
+    Free(root.load());
+  }
+
+  void Insert(int const& v)
+  {
+    Epoch::Guard guard;
+
+    //one entry per level, 0 is the leaf: the node on the path of v, the slot
+    //taken in it, and its copy with v inserted plus the right half of a split;
+    //copies of levels below built stay valid as long as their node is unchanged
+    const Node* path[MaxDepth];
+    int slot[MaxDepth];
+    const Node* copy[MaxDepth];
+    const Node* sibling[MaxDepth];
+    int built = 0;
+
+    const Node* old_root = root.load(std::memory_order_acquire);
+    while (true)
+    {
+      const Node* down[MaxDepth];
+      int downSlot[MaxDepth];
+      int levels = 0;
+      for (const Node* node = old_root; ; )
+      {
+        down[levels] = node;
+        if (node->leaf)
+        {
+          ++levels;
+          break;
+        }
+        const Inner* inner = static_cast<const Inner*>(node);
+        downSlot[levels] = ChildFor(inner, v);
+        node = inner->child[downSlot[levels++]];
+      }
+
+      //versions are immutable, an unchanged node means nothing below it changed
+      int keep = 0;
+      while (keep < built && path[keep] == down[levels - 1 - keep])
+      {
+        ++keep;
+      }
+
+      //nothing of the levels above was published, drop them and copy again
+      for (int level = keep; level < built; ++level)
+      {
+        Delete(copy[level]);
+        if (sibling[level])
+        {
+          Delete(sibling[level]);
+        }
+      }
+
+      for (int level = keep; level < levels; ++level)
+      {
+        path[level] = down[levels - 1 - level];
+        slot[level] = downSlot[levels - 1 - level];
+        sibling[level] = nullptr;
+        copy[level] = level == 0 ?
+          CopyLeaf(static_cast<const Leaf*>(path[0]), v, sibling[0]) :
+          CopyInner(static_cast<const Inner*>(path[level]), slot[level], copy[level - 1], sibling[level - 1], sibling[level]);
+      }
+      built = levels;
+
+      //root split, grow the tree by one level
+      const Node* new_root = copy[levels - 1];
+      if (sibling[levels - 1])
+      {
+        const Node* children[2] = { copy[levels - 1], sibling[levels - 1] };
+        new_root = MakeInner(children, 2);
+      }
+
+      if (root.compare_exchange_weak(old_root, new_root, std::memory_order_acq_rel, std::memory_order_acquire))
+      {
+        //readers may still be walking the old path
+        for (int level = 0; level < levels; ++level)
+        {
+          Epoch::Retire(const_cast<Node*>(path[level]), &DeleteNode);
+        }
+        return;
+      }
+
+      casRetries.fetch_add(1, std::memory_order_relaxed);
+      if (new_root != copy[levels - 1])
+      {
+        Delete(new_root);
+      }
+    }
+  }
+
+  int operator[] (int pos)
+  {
+    return Snapshot()[size_t(pos)];
+  }
+
+  size_t Rank(int v)
+  {
+    return Snapshot().Rank(v);
+  }
+
+  size_t Size()
+  {
+    return Snapshot().size();
+  }
+
+  //number of times a writer lost the CAS and had to copy again
+  unsigned long long GetCASRetryCounter() const { return casRetries.load(std::memory_order_relaxed); }
+
+  //consistent view for many reads, it is not affected by later inserts
+  Version Snapshot()
+  {
+    return Version(root);
+  }
+
+private:
+  static size_t Size(const Node* node)
+  {
+    if (node->leaf)
+    {
+      return size_t(node->count);
+    }
+    const Inner* inner = static_cast<const Inner*>(node);
+    return inner->end[inner->count - 1];
+  }
+
+  static int FirstKey(const Node* node)
+  {
+    if (node->leaf)
+    {
+      return static_cast<const Leaf*>(node)->keys[0];
+    }
+    return static_cast<const Inner*>(node)->firstKey[0];
+  }
+
+  //the child whose range holds the lower bound of v: every key left of it
+  //is less than v and every key right of it is not
+  static int ChildFor(const Inner* inner, int v)
+  {
+    return int(std::lower_bound(inner->firstKey + 1, inner->firstKey + inner->count, v) - inner->firstKey) - 1;
+  }
+
+  static const Node* MakeLeaf(const int* keys, int count)
+  {
+    Leaf* leaf = new Leaf();
+    leaf->leaf = true;
+    leaf->count = count;
+    std::copy(keys, keys + count, leaf->keys);
+    return leaf;
+  }
+
+  static const Node* MakeInner(const Node* const* children, int count)
+  {
+    Inner* inner = new Inner();
+    inner->leaf = false;
+    inner->count = count;
+
+    size_t total = 0;
+    for (int i = 0; i < count; ++i)
+    {
+      inner->child[i] = children[i];
+      inner->firstKey[i] = FirstKey(children[i]);
+      total += Size(children[i]);
+      inner->end[i] = total;
+    }
+
+    return inner;
+  }
+
+  //copy of leaf with v inserted, a leaf that overflows is split in two halves
+  //and the right half is returned through sibling
+  static const Node* CopyLeaf(const Leaf* leaf, int v, const Node*& sibling)
+  {
+    int keys[LeafCapacity + 1];
+    int pos = int(std::lower_bound(leaf->keys, leaf->keys + leaf->count, v) - leaf->keys);
+
+    std::copy(leaf->keys, leaf->keys + pos, keys);
+    keys[pos] = v;
+    std::copy(leaf->keys + pos, leaf->keys + leaf->count, keys + pos + 1);
+
+    int count = leaf->count + 1;
+    if (count <= LeafCapacity)
+    {
+      return MakeLeaf(keys, count);
+    }
+
+    sibling = MakeLeaf(keys + count / 2, count - count / 2);
+    return MakeLeaf(keys, count / 2);
+  }
+
+  //copy of inner with child i replaced by copy, and split added after it
+  //when the child was split; overflows are split like leaves
+  static const Node* CopyInner(const Inner* inner, int i, const Node* copy, const Node* split, const Node*& sibling)
+  {
+    const Node* children[Fanout + 1];
+    std::copy(inner->child, inner->child + inner->count, children);
+    children[i] = copy;
+
+    int count = inner->count;
+    if (split)
+    {
+      std::copy_backward(children + i + 1, children + count, children + count + 1);
+      children[i + 1] = split;
+      ++count;
+    }
+
+    if (count <= Fanout)
+    {
+      return MakeInner(children, count);
+    }
+
+    sibling = MakeInner(children + count / 2, count - count / 2);
+    return MakeInner(children, count / 2);
+  }
+
+  static void DeleteNode(void* node)
+  {
+    Delete(static_cast<const Node*>(node));
+  }
+
+  static void Delete(const Node* node)
+  {
+    if (node->leaf)
+    {
+      delete static_cast<const Leaf*>(node);
+    }
+    else
+    {
+      delete static_cast<const Inner*>(node);
+    }
+  }
+
+  //free a whole version, only used for the last one since older versions share nodes
+  static void Free(const Node* node)
+  {
+    if (!node->leaf)
+    {
+      const Inner* inner = static_cast<const Inner*>(node);
+      for (int i = 0; i < inner->count; ++i)
+      {
+        Free(inner->child[i]);
+      }
+    }
+    Delete(node);
+  }
+
+  std::atomic<const Node*> root;
+  std::atomic<unsigned long long> casRetries;   //failed publishing CAS in Insert
+};
@@ -4,90 +4,63 @@
 #include <vector>         // std::vector
 #include <deque>          // std::deque
 #include <mutex>          // std::mutex
+#include <algorithm>      // std::sort, std::merge
+#include "epoch.h"        // Epoch
 
-//DONT DELETE VECTORS UNTIL THE END
-//This class collects all vectors to delete them at once at the end of program
-//this is so because there is no garauntee how long a thread could hold to old memory
-class MemoryGarbage
-{
+//old vectors are retired to the epoch collector (epoch.h) and freed once no
+//reader can still be holding them, so readers never write to shared memory:
+//a read is an epoch announcement in the thread's own record followed by a
+//seq_cst fence, an acquire load of the current vector and the element access
+class LFSV {
+  std::atomic< std::vector<int>* > pdata;
+  std::atomic<unsigned long long> casRetries;   //failed publishing CAS in Insert and InsertBatch
 public:
-  //keep track of all vectors previously allocated
-  std::vector<std::vector<int>*> pointers;
-  std::atomic<int> counter;
-  std::mutex lock;
-
-  MemoryGarbage() : pointers(10000, nullptr), counter(0), lock()
-  {}
 
-  //delete all vectors
-  ~MemoryGarbage()
-  {
-    size_t size = pointers.size();
-    for (size_t i = 0; i < size; i++)
-    {
-      delete pointers[i];
-    }
-  }
+  //one version of the data, consistent for any number of reads
+  //it keeps its epoch guard for as long as it lives, so it must stay on the
+  //thread that took it
+  class Version {
+  public:
+    Version(const std::atomic< std::vector<int>* >& data) : guard(), pointer(data.load(std::memory_order_acquire)) {}
 
-  //add a new pointer to the to be deleted list
-  void Add(std::vector<int>* pointer)
-  {
-    //using locks since std::vector is not thread safe
-    lock.lock();
+    int operator[] (int pos) const { return (*pointer)[pos]; }
+    size_t size() const { return pointer->size(); }
+    std::vector<int>::const_iterator begin() const { return pointer->begin(); }
+    std::vector<int>::const_iterator end() const { return pointer->end(); }
 
-    //valid pointer
-    if (pointer)
-    {
-      pointers[counter] = pointer;
-      ++counter;
-    }
+  private:
+    Epoch::Guard guard;   //taken before pointer is read
+    const std::vector<int>* pointer;
+  };
 
-    lock.unlock();
-  }
-};
-
-struct Pair {
-  Pair() : pointer(nullptr), ref_count(0) {}
-  Pair(std::vector<int>* data, long count) :pointer(data), ref_count(count) {}
-
-  std::vector<int>* pointer;
-  long              ref_count;
-} __attribute__((aligned(16),packed));
-// for some compilers alignment needed to stop std::atomic<Pair>::load to segfault
-
-class LFSV {
-  MemoryGarbage collector; //collects all vector pointers
-  std::atomic< Pair > pdata;
-public:
-
-  LFSV() : collector(), pdata(Pair{ new std::vector<int>(), 1 })
+  LFSV() : pdata(new std::vector<int>()), casRetries(0)
   {
     //        std::cout << "Is lockfree " << pdata.is_lock_free() << std::endl;
   }
 
   ~LFSV()
   {
-    delete pdata.load().pointer;
+    delete pdata.load();
   }
 
   void Insert(int const& v)
   {
-    Pair pdata_new, pdata_old;
-    pdata_new.pointer = nullptr;
+    Epoch::Guard guard;
+    std::vector<int>* pdata_new = nullptr;
+    std::vector<int>* pdata_old = pdata.load(std::memory_order_acquire);
     do
     {
       //get current data and make a copy
-      delete pdata_new.pointer;
-      pdata_old = pdata.load();
-      pdata_new.pointer = new std::vector<int>(*pdata_old.pointer);
+      delete pdata_new;
+      pdata_new = new std::vector<int>(*pdata_old);
 
       //add element
       // working on a local copy
-      std::vector<int>::iterator b = pdata_new.pointer->begin();
-      std::vector<int>::iterator e = pdata_new.pointer->end();
-      if (b == e || v >= pdata_new.pointer->back())
+      std::vector<int>::iterator b = pdata_new->begin();
+      std::vector<int>::iterator e = pdata_new->end();
+      if (b == e || v >= pdata_new->back())
       {
-        pdata_new.pointer->push_back(v);
+        pdata_new->push_back(v);
       } //first in empty or last element
       else
       {
@@ -95,39 +68,77 @@ public:
         {
           if (*b >= v)
           {
-            pdata_new.pointer->insert(b, v);
+            pdata_new->insert(b, v);
             break;
           }
         }
       }
 
       //if current pointer did not change then update, else repeat insert on new pointer
-    } while (!(this->pdata).compare_exchange_weak(pdata_old, pdata_new));
+      if ((this->pdata).compare_exchange_weak(pdata_old, pdata_new, std::memory_order_acq_rel, std::memory_order_acquire))
+      {
+        break;
+      }
+      casRetries.fetch_add(1, std::memory_order_relaxed);
+    } while (true);
 
-    collector.Add(pdata_old.pointer);
+    Epoch::Retire(pdata_old);
   }
 
-  int operator[] (int pos) { // not a const method anymore
-    Pair pdata_new, pdata_old;
-    // before read - increment counter, check if a writer is using it
-    do
+  //insert a whole range of values with one copy and one CAS
+  //the batch is sorted once and merged into the current vector in O(n + k),
+  //when another writer got in first only the merge against its newer vector
+  //is redone, into the buffer that was already allocated
+  template <typename Iterator>
+  void InsertBatch(Iterator first, Iterator last)
+  {
+    std::vector<int> batch(first, last);
+    if (batch.empty())
     {
-      pdata_old = pdata.load();
-      pdata_new = pdata_old;
-      ++pdata_new.ref_count;
-    } while (!(this->pdata).compare_exchange_weak(pdata_old, pdata_new));
+      return;
+    }
+    std::sort(batch.begin(), batch.end());
 
-    // counter is >1 now - safely read
-    int ret_val = (*pdata_new.pointer)[pos];
+    Epoch::Guard guard;
+    std::vector<int>* pdata_old = pdata.load(std::memory_order_acquire);
+    std::vector<int>* pdata_new = new std::vector<int>();
+    int backoff = 1;
 
-    // before return - decrement counter, check if a writer is using it
-    do
+    for (;;)
     {
-      pdata_old = pdata.load();
-      pdata_new = pdata_old;
-      --pdata_new.ref_count;
-    } while (!(this->pdata).compare_exchange_weak(pdata_old, pdata_new));
+      pdata_new->resize(pdata_old->size() + batch.size());
+      std::merge(pdata_old->begin(), pdata_old->end(), batch.begin(), batch.end(), pdata_new->begin());
+
+      //strong CAS, a spurious failure would cost a whole merge
+      if (pdata.compare_exchange_strong(pdata_old, pdata_new, std::memory_order_acq_rel, std::memory_order_acquire))
+      {
+        break;
+      }
+
+      casRetries.fetch_add(1, std::memory_order_relaxed);
+
+      //contended, give the winner some room before merging again
+      for (int i = 0; i < backoff; ++i)
+      {
+        std::this_thread::yield();
+      }
+      backoff = std::min(backoff * 2, 64);
+    }
+
+    Epoch::Retire(pdata_old);
+  }
+
+  int operator[] (int pos) { // not a const method anymore
+    Epoch::Guard guard;
+    return (*pdata.load(std::memory_order_acquire))[pos];
+  }
+
+  //number of times a writer lost the CAS and had to copy again
+  unsigned long long GetCASRetryCounter() const { return casRetries.load(std::memory_order_relaxed); }
+  void ResetCounters() { casRetries.store(0, std::memory_order_relaxed); }
 
-    return ret_val;
+  //handle for many indexed reads against one version
+  Version Snapshot() {
+    return Version(pdata);
   }
 };
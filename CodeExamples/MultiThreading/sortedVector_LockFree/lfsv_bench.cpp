@@ -0,0 +1,371 @@
+//Contention benchmark for LFSV and LFST against a std::mutex and a std::shared_mutex protected vector
+//every run prefills the container, then reader and writer threads hammer it for a
+//fixed time; one CSV row is printed per container, mix, key distribution, size and
+//operation type
+//build: g++ -O2 -std=c++17 -pthread lfsv_bench.cpp -o lfsv_bench
+//usage: lfsv_bench [-s 1000,10000,100000] [-m 1:1,4:1,1:4,0:4] [-k ascending,random,hotspot] [-d seconds]
+#include "lfsv.h"
+#include "lfst.h"
+#include <shared_mutex>
+#include <chrono>
+#include <random>
+#include <sstream>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <new>
+
+//bytes handed out by operator new to the calling thread, for bytes allocated
+//per operation; per thread so counting does not add a shared cache line the
+//workers contend on (kept out of line, gcc flags the malloc/free pair once
+//they are inlined)
+static thread_local unsigned long long threadAllocatedBytes = 0;
+
+__attribute__((noinline)) void* operator new(size_t size)
+{
+  threadAllocatedBytes += size;
+  if (void* p = std::malloc(size ? size : 1))
+  {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept
+{
+  std::free(p);
+}
+
+//baseline, one lock for everything
+class MutexVector
+{
+public:
+  void Insert(int const& v)
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    data.insert(std::lower_bound(data.begin(), data.end(), v), v);
+  }
+
+  template <typename Iterator>
+  void InsertBatch(Iterator first, Iterator last)
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    data.insert(data.end(), first, last);
+    std::sort(data.begin(), data.end());
+  }
+
+  int operator[] (int pos)
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    return data[pos];
+  }
+
+  unsigned long long GetCASRetryCounter() const { return 0; }
+
+private:
+  std::mutex lock;
+  std::vector<int> data;
+};
+
+//baseline, readers share the lock
+class SharedMutexVector
+{
+public:
+  void Insert(int const& v)
+  {
+    std::unique_lock<std::shared_mutex> guard(lock);
+    data.insert(std::lower_bound(data.begin(), data.end(), v), v);
+  }
+
+  template <typename Iterator>
+  void InsertBatch(Iterator first, Iterator last)
+  {
+    std::unique_lock<std::shared_mutex> guard(lock);
+    data.insert(data.end(), first, last);
+    std::sort(data.begin(), data.end());
+  }
+
+  int operator[] (int pos)
+  {
+    std::shared_lock<std::shared_mutex> guard(lock);
+    return data[pos];
+  }
+
+  unsigned long long GetCASRetryCounter() const { return 0; }
+
+private:
+  std::shared_mutex lock;
+  std::vector<int> data;
+};
+
+//prefilled keys and random keys are below this
+const int KeyRange = 1000000;
+
+//key generator for one writer thread, ascending keys start above the prefill
+//so every insert appends
+class Keys
+{
+public:
+  Keys(const std::string& Kind, int thread, int threads) :
+    kind(Kind), rng(thread + 1), next(KeyRange + thread), step(threads)
+  {}
+
+  int operator()()
+  {
+    if (kind == "ascending")
+    {
+      int key = next;
+      next += step;
+      return key;
+    }
+
+    if (kind == "hotspot")
+    {
+      //90% of the keys fall into 1% of the range
+      if (rng() % 10)
+      {
+        return int(rng() % 10000);
+      }
+    }
+
+    return int(rng() % KeyRange);
+  }
+
+private:
+  std::string kind;
+  std::mt19937 rng;
+  int next;
+  int step;
+};
+
+struct Samples
+{
+  Samples() : operations(0), bytes(0), nanos() {}
+  unsigned long long operations;
+  unsigned long long bytes;         //allocated by this thread while running
+  std::vector<long long> nanos;     //latency of every operation, capped
+};
+
+const size_t MaxSamples = 1 << 20;
+
+double Percentile(std::vector<long long>& values, double p)
+{
+  if (values.empty())
+  {
+    return 0.0;
+  }
+  std::sort(values.begin(), values.end());
+  return double(values[std::min(values.size() - 1, size_t(p * (values.size() - 1) + 0.5))]);
+}
+
+//prefill in one batch, single inserts would copy LFSV size times
+template <typename Container>
+void Prefill(Container& container, std::vector<int> const& initial)
+{
+  container.InsertBatch(initial.begin(), initial.end());
+}
+
+//LFST has no batch insert, single inserts only copy one path each
+void Prefill(LFST& container, std::vector<int> const& initial)
+{
+  for (size_t i = 0; i < initial.size(); ++i)
+  {
+    container.Insert(initial[i]);
+  }
+}
+
+struct Mix
+{
+  int readers;
+  int writers;
+};
+
+template <typename Container>
+void Run(const char* name, int size, Mix mix, const std::string& kind, double seconds)
+{
+  Container container;
+  std::mt19937 fill(7);
+  std::vector<int> initial(size);
+  for (int i = 0; i < size; ++i)
+  {
+    initial[i] = int(fill() % KeyRange);
+  }
+  Prefill(container, initial);
+  unsigned long long retriesBefore = container.GetCASRetryCounter();
+
+  std::atomic<bool> start(false), stop(false);
+  std::vector<Samples> reads(mix.readers), writes(mix.writers);
+  std::vector<std::thread> threads;
+
+  //reserved here, before any worker exists, so no sample buffer is
+  //allocated while the others already run
+  for (int r = 0; r < mix.readers; ++r)
+  {
+    reads[r].nanos.reserve(MaxSamples);
+  }
+  for (int w = 0; w < mix.writers; ++w)
+  {
+    writes[w].nanos.reserve(MaxSamples);
+  }
+
+  for (int r = 0; r < mix.readers; ++r)
+  {
+    threads.push_back(std::thread([&container, &start, &stop, &reads, size, r]()
+    {
+      std::mt19937 rng(r + 100);
+      Samples& samples = reads[r];
+      volatile int sink = 0;
+      while (!start.load()) {}
+      unsigned long long bytesBefore = threadAllocatedBytes;
+      while (!stop.load(std::memory_order_relaxed))
+      {
+        int pos = int(rng() % size);
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        sink = container[pos];
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        if (samples.nanos.size() < MaxSamples)
+        {
+          samples.nanos.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count());
+        }
+        ++samples.operations;
+      }
+      samples.bytes = threadAllocatedBytes - bytesBefore;
+      (void)sink;
+    }));
+  }
+
+  for (int w = 0; w < mix.writers; ++w)
+  {
+    threads.push_back(std::thread([&container, &start, &stop, &writes, &kind, &mix, w]()
+    {
+      Keys keys(kind, w, mix.writers);
+      Samples& samples = writes[w];
+      while (!start.load()) {}
+      unsigned long long bytesBefore = threadAllocatedBytes;
+      while (!stop.load(std::memory_order_relaxed))
+      {
+        int key = keys();
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        container.Insert(key);
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        if (samples.nanos.size() < MaxSamples)
+        {
+          samples.nanos.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count());
+        }
+        ++samples.operations;
+      }
+      samples.bytes = threadAllocatedBytes - bytesBefore;
+    }));
+  }
+
+  std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+  start.store(true);
+  std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+  stop.store(true);
+  for (size_t i = 0; i < threads.size(); ++i)
+  {
+    threads[i].join();
+  }
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+  unsigned long long retries = container.GetCASRetryCounter() - retriesBefore;
+
+  std::vector<Samples>* groups[2] = { &reads, &writes };
+  const char* types[2] = { "read", "insert" };
+  unsigned long long total = 0, bytes = 0;
+  for (int g = 0; g < 2; ++g)
+  {
+    for (size_t i = 0; i < groups[g]->size(); ++i)
+    {
+      total += (*groups[g])[i].operations;
+      bytes += (*groups[g])[i].bytes;
+    }
+  }
+
+  for (int g = 0; g < 2; ++g)
+  {
+    if (groups[g]->empty())
+    {
+      continue;
+    }
+
+    unsigned long long operations = 0;
+    std::vector<long long> nanos;
+    for (size_t i = 0; i < groups[g]->size(); ++i)
+    {
+      operations += (*groups[g])[i].operations;
+      nanos.insert(nanos.end(), (*groups[g])[i].nanos.begin(), (*groups[g])[i].nanos.end());
+    }
+
+    std::cout << name << ','
+      << mix.readers << ':' << mix.writers << ','
+      << kind << ','
+      << size << ','
+      << types[g] << ','
+      << operations / elapsed << ','
+      << Percentile(nanos, 0.50) << ','
+      << Percentile(nanos, 0.99) << ','
+      << retries << ','
+      << (total ? double(bytes) / total : 0.0) << std::endl;
+  }
+}
+
+std::vector<std::string> Split(const char* text)
+{
+  std::vector<std::string> items;
+  std::stringstream stream(text);
+  std::string item;
+  while (std::getline(stream, item, ','))
+  {
+    items.push_back(item);
+  }
+  return items;
+}
+
+int main(int argc, char** argv)
+{
+  std::vector<std::string> sizes = Split("1000,10000,100000");
+  std::vector<std::string> mixes = Split("1:1,4:1,1:4,0:4");
+  std::vector<std::string> kinds = Split("ascending,random,hotspot");
+  double seconds = 0.5;
+
+  for (int i = 1; i + 1 < argc; i += 2)
+  {
+    if (!std::strcmp(argv[i], "-s")) sizes = Split(argv[i + 1]);
+    else if (!std::strcmp(argv[i], "-m")) mixes = Split(argv[i + 1]);
+    else if (!std::strcmp(argv[i], "-k")) kinds = Split(argv[i + 1]);
+    else if (!std::strcmp(argv[i], "-d")) seconds = std::atof(argv[i + 1]);
+    else
+    {
+      std::cerr << "unknown option " << argv[i] << std::endl;
+      return 1;
+    }
+  }
+
+  std::cout << "container,readers:writers,keys,size,operation,ops_per_sec,p50_ns,p99_ns,cas_retries,bytes_per_op" << std::endl;
+
+  for (size_t s = 0; s < sizes.size(); ++s)
+  {
+    int size = std::max(1, std::atoi(sizes[s].c_str()));
+    for (size_t m = 0; m < mixes.size(); ++m)
+    {
+      Mix mix;
+      mix.readers = std::atoi(mixes[m].c_str());
+      mix.writers = std::atoi(mixes[m].c_str() + mixes[m].find(':') + 1);
+
+      for (size_t k = 0; k < kinds.size(); ++k)
+      {
+        Run<LFSV>("lfsv", size, mix, kinds[k], seconds);
+        Run<LFST>("lfst", size, mix, kinds[k], seconds);
+        Run<MutexVector>("mutex", size, mix, kinds[k], seconds);
+        Run<SharedMutexVector>("shared_mutex", size, mix, kinds[k], seconds);
+      }
+    }
+  }
+
+  return 0;
+}
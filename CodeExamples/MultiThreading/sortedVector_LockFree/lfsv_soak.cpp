@@ -0,0 +1,239 @@
+//Soak test for the epoch collector behind LFSV and LFST
+//millions of inserts run against concurrent readers while the number of
+//retired but not yet freed objects and the resident set size are tracked;
+//the backlog of retired objects must not grow over the run and must drain
+//to nothing once the threads are gone
+//build: g++ -O2 -std=c++17 -pthread lfsv_soak.cpp -o lfsv_soak
+//usage: lfsv_soak [total_inserts] [writers] [readers]
+#include "lfsv.h"
+#include "lfst.h"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <random>
+#include <cstdlib>
+
+//resident set size in kB
+long ResidentKB()
+{
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line))
+  {
+    if (line.compare(0, 6, "VmRSS:") == 0)
+    {
+      return std::atol(line.c_str() + 6);
+    }
+  }
+  return 0;
+}
+
+struct Watch
+{
+  Watch() : pending(), maxResident(0) {}
+
+  void Sample()
+  {
+    pending.push_back(Epoch::Pending());
+    maxResident = std::max(maxResident, ResidentKB());
+  }
+
+  size_t MaxPending(size_t begin, size_t end) const
+  {
+    size_t result = 0;
+    for (size_t i = begin; i < end; ++i)
+    {
+      result = std::max(result, pending[i]);
+    }
+    return result;
+  }
+
+  //the backlog in the second half of the run may not be much bigger than in
+  //the first half, a leak grows with the number of inserts
+  bool Bounded() const
+  {
+    size_t half = pending.size() / 2;
+    return MaxPending(half, pending.size()) <= 2 * MaxPending(0, half) + 1024;
+  }
+
+  std::vector<size_t> pending;
+  long maxResident;
+};
+
+//with no thread inside a guard two epochs are enough to free everything
+size_t Drain()
+{
+  for (int i = 0; i < 3; ++i)
+  {
+    Epoch::Collect();
+  }
+  return Epoch::Pending();
+}
+
+//LFSV copies the whole vector per insert, so the inserts are spread over
+//many small containers that are created and destroyed in turn
+bool SoakLFSV(long total, int writers, int readers, Watch& watch)
+{
+  const int prefill = 64;
+  const int perWriter = 250;
+  bool ok = true;
+  long done = 0;
+
+  while (done < total)
+  {
+    LFSV lfsv;
+    for (int i = 0; i < prefill; ++i)
+    {
+      lfsv.Insert(i * 3);
+    }
+
+    std::atomic<bool> stop(false);
+    std::vector<std::thread> threads;
+
+    for (int r = 0; r < readers; ++r)
+    {
+      threads.push_back(std::thread([&lfsv, &stop, r]()
+      {
+        std::mt19937 rng(r);
+        while (!stop.load())
+        {
+          lfsv[int(rng() % prefill)];
+        }
+      }));
+    }
+
+    std::vector<std::thread> writing;
+    for (int w = 0; w < writers; ++w)
+    {
+      writing.push_back(std::thread([&lfsv, w]()
+      {
+        std::mt19937 rng(w + 1000);
+        for (int i = 0; i < perWriter; ++i)
+        {
+          lfsv.Insert(int(rng() % 100000));
+        }
+      }));
+    }
+
+    for (size_t i = 0; i < writing.size(); ++i)
+    {
+      writing[i].join();
+    }
+    stop.store(true);
+    for (size_t i = 0; i < threads.size(); ++i)
+    {
+      threads[i].join();
+    }
+
+    int size = prefill + writers * perWriter;
+    for (int i = 1; i < size; ++i)
+    {
+      if (lfsv[i - 1] > lfsv[i])
+      {
+        ok = false;
+      }
+    }
+
+    done += writers * perWriter;
+    watch.Sample();
+  }
+
+  return ok;
+}
+
+bool SoakLFST(long total, int writers, int readers, Watch& watch)
+{
+  LFST lfst;
+  lfst.Insert(0);
+
+  std::atomic<bool> stop(false);
+  std::atomic<bool> ok(true);
+  std::vector<std::thread> threads;
+
+  for (int r = 0; r < readers; ++r)
+  {
+    threads.push_back(std::thread([&lfst, &stop, &ok, r]()
+    {
+      std::mt19937 rng(r);
+      while (!stop.load())
+      {
+        LFST::Version version = lfst.Snapshot();
+        size_t size = version.size();
+        size_t pos = rng() % size;
+        if (pos && version[pos - 1] > version[pos])
+        {
+          ok.store(false);
+        }
+      }
+    }));
+  }
+
+  long perWriter = total / writers;
+  std::vector<std::thread> writing;
+  for (int w = 0; w < writers; ++w)
+  {
+    writing.push_back(std::thread([&lfst, &watch, perWriter, w]()
+    {
+      std::mt19937 rng(w + 1000);
+      for (long i = 0; i < perWriter; ++i)
+      {
+        lfst.Insert(int(rng() % 1000000) + 1);
+        if (w == 0 && i % 65536 == 0)
+        {
+          watch.Sample();
+        }
+      }
+    }));
+  }
+
+  for (size_t i = 0; i < writing.size(); ++i)
+  {
+    writing[i].join();
+  }
+  stop.store(true);
+  for (size_t i = 0; i < threads.size(); ++i)
+  {
+    threads[i].join();
+  }
+
+  if (lfst.Size() != size_t(perWriter * writers + 1))
+  {
+    ok.store(false);
+  }
+
+  watch.Sample();
+  return ok.load();
+}
+
+int main(int argc, char** argv)
+{
+  long total = argc > 1 ? std::atol(argv[1]) : 2000000;
+  int writers = argc > 2 ? std::atoi(argv[2]) : 4;
+  int readers = argc > 3 ? std::atoi(argv[3]) : 4;
+  bool ok = true;
+
+  Watch lfsv;
+  if (!SoakLFSV(total, writers, readers, lfsv))
+  {
+    std::cout << "LFSV: contents not sorted" << std::endl;
+    ok = false;
+  }
+  size_t left = Drain();
+  std::cout << "LFSV: " << total << " inserts, max pending " << lfsv.MaxPending(0, lfsv.pending.size())
+    << ", pending after drain " << left << ", max rss " << lfsv.maxResident << " kB" << std::endl;
+  ok = ok && lfsv.Bounded() && !left;
+
+  Watch lfst;
+  if (!SoakLFST(total, writers, readers, lfst))
+  {
+    std::cout << "LFST: contents not sorted or wrong size" << std::endl;
+    ok = false;
+  }
+  left = Drain();
+  std::cout << "LFST: " << total << " inserts, max pending " << lfst.MaxPending(0, lfst.pending.size())
+    << ", pending after drain " << left << ", max rss " << lfst.maxResident << " kB" << std::endl;
+  ok = ok && lfst.Bounded() && !left;
+
+  std::cout << (ok ? "PASS" : "FAIL") << std::endl;
+  return ok ? 0 : 1;
+}